@@ -1,137 +1,234 @@
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 #include "ast.h"
+#include "printtree.h"
 
-// Constructors for terminal and nonterminal
-Terminal::Terminal(token c) { this->c = c; };
-NonTerminal::NonTerminal(nonterminal X) { this->X = X; };
+/* Spellings of the fixed symbols: the token names (names[] in parse.cpp),
+   then the labels the parsers give nodes that stand for no single token */
+static const string_view fixed_labels[] = {"read", "write", "id", "literal", ":=",
+    "+", "-", "*", "/", "(", ")", "if", "while", "end", "=", "<>", "<", ">", "<=", ">=", "eof",
+    "program", "num", "ERROR", ""};
+static_assert(size(fixed_labels) == n_fixed_symbols, "a fixed symbol has no spelling");
 
-// Intializes empty symbol
-Symbol::Symbol() {
-    this->c = t_null;
-    this->X = nt_null;
-    this->e = e_null;
+/* Arena starts empty but for the fixed symbols; the first allocation grabs a block */
+Arena::Arena() {
+    this->next = nullptr;
+    this->limit = nullptr;
+    this->bytes = 0;
+    seed();
 }
 
-// Initializes symbol as terminal
-Symbol::Symbol(token c) {
-    this->c = Terminal(c);
-    this->X = nt_null;
-    this->e = e_null;
-};
+/* Enters the fixed symbols, whose spellings are static */
+void Arena::seed() {
+    symbols.assign(begin(fixed_labels), end(fixed_labels));
+    for (uint32_t i = 0; i < n_fixed_symbols; i++) {
+        symbol_index[fixed_labels[i]] = i;
+    }
+}
 
-// Initializes symbol as nonterminal
-Symbol::Symbol(nonterminal X) {
-    this->c = t_null;
-    this->X = NonTerminal(X);
-    this->e = e_null;
-};
+Arena::~Arena() {
+    for (char* b : blocks) {
+        free(b);
+    }
+}
 
-// Initializes symbol as epsilon
-Symbol::Symbol(EPSILON e) {
-    this->c = t_null;
-    this->X = nt_null;
-    this->e = EPS;
-};
+/* Bumps the current block, or starts a new one when it is full */
+void* Arena::allocate(size_t size, size_t align) {
+    char* p = (char*) ((uintptr_t(next) + align - 1) & ~(uintptr_t(align) - 1));
+    if (next == nullptr || p + size > limit) {
+        size_t n = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+        char* b = (char*) malloc(n);
+        if (b == nullptr) {
+            cout << "Out of memory.\n";
+            exit(1);
+        }
+        blocks.push_back(b);
+        limit = b + n;
+        p = (char*) ((uintptr_t(b) + align - 1) & ~(uintptr_t(align) - 1));
+    }
+    next = p + size;
+    bytes += size;
+    return p;
+}
 
-// Returns true if symbol is terminal
-bool Symbol::isTerminal() {
-    return this->c.c != t_null;
-};
+/* Interns a label so each distinct string is stored once per parse */
+uint32_t Arena::intern(string_view s) {
+    auto found = symbol_index.find(s);
+    if (found != symbol_index.end()) {
+        return found->second;
+    }
+    char* copy = (char*) allocate(s.size(), 1);
+    s.copy(copy, s.size());
+    string_view owned(copy, s.size());
+    uint32_t symbol = symbols.size();
+    symbols.push_back(owned);
+    symbol_index[owned] = symbol;
+    return symbol;
+}
 
-// Returns true if symbol is nonterminal
-bool Symbol::isNonTerminal() {
-    return this->X.X != nt_null;
-};
+/* Moves other's blocks into this arena. Its spellings stay where they are,
+   in blocks that are now this arena's. */
+vector<uint32_t> Arena::adopt(Arena& other) {
+    vector<uint32_t> to(other.symbols.size());
+    for (uint32_t i = 0; i < other.symbols.size(); i++) {
+        auto inserted = symbol_index.insert({other.symbols[i], symbols.size()});
+        if (inserted.second) symbols.push_back(other.symbols[i]);
+        to[i] = inserted.first->second;
+    }
+    blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+    bytes += other.bytes;
+    for (int k = 0; k < 3; k++) {
+        nodes[k] += other.nodes[k];
+        other.nodes[k] = 0;
+    }
+    other.blocks.clear();
+    other.next = other.limit = nullptr;
+    other.bytes = 0;
+    other.symbols.clear();
+    other.symbol_index.clear();
+    other.seed();
+    return to;
+}
 
-// Returns true if symbol is epsilon
-bool Symbol::isEpsilon() {
-    return this->e == EPS;
-};
+/* Releases every block at once */
+void Arena::reset() {
+    for (char* b : blocks) {
+        free(b);
+    }
+    blocks.clear();
+    next = limit = nullptr;
+    bytes = 0;
+    fill(begin(nodes), end(nodes), 0);
+    symbols.clear();
+    symbol_index.clear();
+    seed();
+}
 
 /* AST node constructor */
-AST_Node::AST_Node(string terminal) {
-    this->terminal = terminal;
-    this->children = vector <AST_Node*> ();
-};
+AST_Node::AST_Node(Arena& arena, uint32_t label) {
+    this->label = label;
+}
+
+/* Constructor for a labelled node with one child */
+AST_Node::AST_Node(Arena& arena, uint32_t label, AST_Node* c) {
+    this->label = label;
+    this->offset = c->offset;
+    children.reserve(arena, 1);
+    children.push_back(arena, c);
+}
+
 /* Constructor for one child */
-AST_Node::AST_Node(AST_Node* p, AST_Node* c) {
-    this->terminal = p->terminal;
-    this->children = vector <AST_Node*> ();
-    children.push_back(c);
+AST_Node::AST_Node(Arena& arena, AST_Node* p, AST_Node* c) {
+    this->label = p->label;
+    this->offset = p->offset;
+    children.reserve(arena, 1);
+    children.push_back(arena, c);
 }
 
 /* Constructor for two children */
-AST_Node::AST_Node(AST_Node* p, AST_Node* l, AST_Node* r) {
-    this->terminal = p->terminal;
-    this->children = vector <AST_Node*> ();
-    children.push_back(l);
-    children.push_back(r);
+AST_Node::AST_Node(Arena& arena, AST_Node* p, AST_Node* l, AST_Node* r) {
+    this->label = p->label;
+    this->offset = p->offset;
+    children.reserve(arena, 2);
+    children.push_back(arena, l);
+    children.push_back(arena, r);
 }
 
 /* Constructor for three children */
-AST_Node::AST_Node(AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) {
-    this->terminal = p->terminal;
-    this->children = vector <AST_Node*> ();
-    children.push_back(l);
-    children.push_back(m);
-    children.push_back(r);
-}
-
-/* Prints the given node */
-void AST_Node::printAST_Node(int indent) {
-    if (children.empty()) {
-        cout << terminal;
-    } else {  
-        cout << "(" << terminal << " ";
-        int n = children.size();
-        if (n > 1) {
-            for (int i = 0; i < n - 1; i++) {
-                children.at(i)->printAST_Node(indent);
-                cout << " ";
-            }
-        }
-    if (n > 0) {
-        children.back()->printAST_Node(indent);
-    }
-    cout << ")";
+AST_Node::AST_Node(Arena& arena, AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) {
+    this->label = p->label;
+    this->offset = p->offset;
+    children.reserve(arena, 3);
+    children.push_back(arena, l);
+    children.push_back(arena, m);
+    children.push_back(arena, r);
+}
+
+/* Pointer tree as seen by printTree: a cursor is an index into children */
+struct PointerTree {
+    const Arena& arena;
+    typedef const AST_Node* Node;
+    typedef size_t Cursor;
+    NodeKind kind(Node n) const { return n->kind; }
+    string_view label(Node n) const { return arena.label(n->label); }
+    Cursor first(Node n) const { return 0; }
+    bool done(Node n, Cursor c) const { return c == n->children.size(); }
+    Node child(Node n, Cursor c) const { return n->children[c]; }
+    Cursor next(Node n, Cursor c) const { return c + 1; }
+};
+
+/* Prints the given node and its subtree. Statement lists and branch
+   statements print on several lines; their contents are indented. */
+void AST_Node::printAST_Node(int indent, const Arena& arena, ostream& out) {
+    Emitter emitter(out);
+    printTree(emitter, PointerTree {arena}, this, indent);
+}
+
+void AST_Node::printAST_Node(int indent, const Arena& arena, Emitter& out) {
+    printTree(out, PointerTree {arena}, this, indent);
+}
+
+void relabel(AST_Node* root, const vector<uint32_t>& to) {
+    vector <AST_Node*> pending = {root};
+    while (!pending.empty()) {
+        AST_Node* n = pending.back();
+        pending.pop_back();
+        n->label = to[n->label];
+        pending.insert(pending.end(), n->children.begin(), n->children.end());
     }
 }
 
-/* Prints a statement list node */
-void SL_Node::printAST_Node(int indent) {
-    indent += 2;
-    int n = children.size();
-    cout << "\n";
-    printIndent(indent);
-    cout << "[ ";
-    children.front()->printAST_Node(indent);
-    if (n > 1) {
-        for (int i = 1; i < n; i++) {
-            cout << "\n";
-            printIndent(indent+2);
-            children.at(i)->printAST_Node(indent); 
+/* Flattens the tree in pre-order without recursion. last_child[i] is the most
+   recently placed child of node i, used to link in its next sibling. Labels
+   are numbered in order of first use; label_index maps a symbol to its. */
+FlatAST::FlatAST(const AST_Node* root, const Arena& arena) {
+    vector <uint32_t> label_index(arena.symbolCount(), FLAT_NONE);
+    vector <uint32_t> last_child;
+    vector <pair<const AST_Node*, uint32_t>> pending; // node and its parent's index
+    pending.push_back({root, FLAT_NONE});
+    while (!pending.empty()) {
+        const AST_Node* n = pending.back().first;
+        uint32_t parent = pending.back().second;
+        pending.pop_back();
+
+        uint32_t& label = label_index[n->label];
+        if (label == FLAT_NONE) {
+            label = labels.size();
+            labels.push_back(arena.label(n->label));
+        }
+
+        uint32_t i = nodes.size();
+        nodes.push_back({n->kind, label, FLAT_NONE, FLAT_NONE});
+        last_child.push_back(FLAT_NONE);
+        if (parent != FLAT_NONE) {
+            if (last_child[parent] == FLAT_NONE) {
+                nodes[parent].first_child = i;
+            } else {
+                nodes[last_child[parent]].next_sibling = i;
+            }
+            last_child[parent] = i;
+        }
+        for (size_t c = n->children.size(); c > 0; c--) {
+            pending.push_back({n->children.at(c - 1), i});
         }
     }
-    cout << "\n";
-    printIndent(indent);
-    cout << "]\n";
-}
-
-/* Prints a branch statement node */
-void B_Node::printAST_Node(int indent) {
-    indent += 2;
-    cout << "(" << terminal << "\n";
-    for (int i = 0; i < int(children.size()) ; i++) {
-        printIndent(indent+2);
-        children.at(i)->printAST_Node(indent);
-    }
-    printIndent(indent);
-    cout << ")";
 }
 
-/* Prints a given number of indents */
-void AST_Node::printIndent(int indent) {
-    for (int i = 0; i < indent; i++) {
-        cout << " ";
-    }
-}
\ No newline at end of file
+/* Flat array as seen by printTree: a cursor is the index of the child */
+struct ArrayTree {
+    const FlatAST& ast;
+    typedef uint32_t Node;
+    typedef uint32_t Cursor;
+    NodeKind kind(Node n) const { return ast.nodes[n].kind; }
+    string_view label(Node n) const { return ast.labels[ast.nodes[n].label]; }
+    Cursor first(Node n) const { return ast.nodes[n].first_child; }
+    bool done(Node n, Cursor c) const { return c == FLAT_NONE; }
+    Node child(Node n, Cursor c) const { return c; }
+    Cursor next(Node n, Cursor c) const { return ast.nodes[c].next_sibling; }
+};
+
+void FlatAST::print(ostream& out) const {
+    Emitter emitter(out);
+    printTree(emitter, ArrayTree {*this}, 0, 0);
+}
@@ -1,5 +1,13 @@
+#ifndef AST_H
+#define AST_H
+
 #include <vector>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <type_traits>
+#include "emit.h"
 #include "scan.h"
 
 using namespace std;
@@ -7,7 +15,7 @@ using namespace std;
 class Terminal {
     public:
         token c;
-        Terminal(token c = t_null);
+        constexpr Terminal(token c = t_null) : c(c) { }
         bool operator==(Terminal& other) const
          {
              if(this->c == other.c) return true;
@@ -19,7 +27,7 @@ class Terminal {
 class NonTerminal {
     public:
         nonterminal X;
-        NonTerminal(nonterminal X = nt_null);
+        constexpr NonTerminal(nonterminal X = nt_null) : X(X) { }
         bool operator==(NonTerminal& other) const
          {
              if(this->X == other.X) return true;
@@ -28,7 +36,8 @@ class NonTerminal {
 
 };
 
-// A symbol can be a terminal, nonterminal, or epsilon
+// A symbol can be a terminal, nonterminal, or epsilon.
+// Constructors are constexpr so the grammar can be a compile-time table.
 class Symbol {
     public:
         // Default is null, unless symbol is of given type
@@ -37,15 +46,15 @@ class Symbol {
         EPSILON e;
 
         // Constructors
-        Symbol();
-        Symbol(token c); 
-        Symbol(nonterminal X);
-        Symbol(EPSILON e);
+        constexpr Symbol() : c(t_null), X(nt_null), e(e_null) { }
+        constexpr Symbol(token c) : c(c), X(nt_null), e(e_null) { }
+        constexpr Symbol(nonterminal X) : c(t_null), X(X), e(e_null) { }
+        constexpr Symbol(EPSILON e) : c(t_null), X(nt_null), e(EPS) { }
 
         // Functions
-        bool isTerminal(); // returns true if symbol is terminal
-        bool isNonTerminal(); // returns true if symbol is nonterminal
-        bool isEpsilon(); // returns true if symbol is epsilon
+        constexpr bool isTerminal() const { return c.c != t_null; } // returns true if symbol is terminal
+        constexpr bool isNonTerminal() const { return X.X != nt_null; } // returns true if symbol is nonterminal
+        constexpr bool isEpsilon() const { return e == EPS; } // returns true if symbol is epsilon
 
         bool operator==(Symbol& other) const
          {
@@ -55,43 +64,176 @@ class Symbol {
          };
 };
 
-/* Node for an abstract syntax tree */
+/* How a node prints: plain S-expression, statement list, or branch statement */
+enum NodeKind : uint8_t {n_plain, n_list, n_branch};
+
+class AST_Node;
+
+/* Symbols every arena starts with. The token names come first, in token
+   order, so the label of a keyword or operator token t is symbol t. */
+enum fixed_symbol : uint32_t {s_program = t_null, s_num, s_error, s_empty, n_fixed_symbols};
+
+/* Bump allocator for the nodes of one parse. Memory is carved out of large
+   blocks and is only released all at once, by reset() or the destructor.
+   Objects allocated here are never destroyed individually, so they must be
+   trivially destructible. */
+class Arena {
+    public:
+        Arena();
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(size_t size, size_t align);
+
+        /* Constructs a T in the arena, passing the arena as the first argument */
+        template <class T, class... Args> T* make(Args&&... args) {
+            T* made = new (allocate(sizeof(T), alignof(T))) T(*this, std::forward<Args>(args)...);
+            if constexpr (is_base_of_v<AST_Node, T>) STAT(nodes[made->kind]++);
+            return made;
+        }
+
+        /* The arena is also the parse's symbol table: intern returns the
+           symbol for s, copying s into the arena the first time it is seen,
+           and label returns a symbol's spelling. */
+        uint32_t intern(string_view s);
+        string_view label(uint32_t symbol) const { return symbols[symbol]; }
+        uint32_t symbolCount() const { return symbols.size(); }
+
+        /* Frees every object and symbol allocated so far */
+        void reset();
+
+        /* Takes over every block of other, so its objects live as long as
+           this arena, and interns its symbols. Returns the new symbol of
+           each of other's symbols; nodes taken over must be relabelled with
+           it (relabel). other is left empty. */
+        vector<uint32_t> adopt(Arena& other);
+
+        size_t bytesAllocated() const { return bytes; }
+        /* Nodes of kind k made here since the last reset, adopted ones
+           included (stats.h) */
+        uint64_t nodeCount(NodeKind k) const { return nodes[k]; }
+    private:
+        static const size_t BLOCK_SIZE = 1 << 20;
+        vector<char*> blocks;
+        char* next;
+        char* limit;
+        size_t bytes;
+        uint64_t nodes[3] = {};
+        vector<string_view> symbols;
+        unordered_map<string_view, uint32_t> symbol_index;
+
+        void seed();
+};
+
+/* Growable array whose storage lives in an arena. Growing abandons the old
+   storage to the arena, which is cheap since lists are built once. */
+template <class T> class ArenaVector {
+    public:
+        ArenaVector() : items(nullptr), count(0), capacity(0) { }
+
+        void push_back(Arena& arena, T item) {
+            if (count == capacity) {
+                reserve(arena, capacity ? 2 * capacity : 4);
+            }
+            items[count++] = item;
+        }
+
+        void reserve(Arena& arena, uint32_t n) {
+            if (n <= capacity) return;
+            T* grown = (T*) arena.allocate(n * sizeof(T), alignof(T));
+            for (uint32_t i = 0; i < count; i++) grown[i] = items[i];
+            items = grown;
+            capacity = n;
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        T& at(size_t i) const { return items[i]; }
+        T& operator[](size_t i) const { return items[i]; }
+        T& front() const { return items[0]; }
+        T& back() const { return items[count - 1]; }
+        T* begin() const { return items; }
+        T* end() const { return items + count; }
+    private:
+        T* items;
+        uint32_t count;
+        uint32_t capacity;
+};
+
+/* Source offset of a node that has no token of its own */
+const uint32_t NO_OFFSET = UINT32_MAX;
+
+/* Node for an abstract syntax tree. Nodes are created with Arena::make. */
 class AST_Node {
     public:
-        string terminal; // what will actually be printed
-        vector <AST_Node*> children; // list of children nodes
+        uint32_t label; // symbol of what will actually be printed (Arena::label)
+        ArenaVector <AST_Node*> children; // list of children nodes
+        NodeKind kind = n_plain;
+        /* Byte offset in the source of the token the node stands for: the
+           operator or keyword of an interior node, the operand of an id or
+           num wrapper. Inserted tokens get the offset they were inserted at. */
+        uint32_t offset = NO_OFFSET;
 
         /* Constructor for a single node with no children */
-        AST_Node(string terminal = "");
+        AST_Node(Arena& arena, uint32_t label = s_empty);
+        /* Constructor for a node with the given label and one child */
+        AST_Node(Arena& arena, uint32_t label, AST_Node* c);
         /* Constructors take the first parameter as the parent node, the rest are added as children */
-        AST_Node(AST_Node* p, AST_Node* c);
-        AST_Node(AST_Node* p, AST_Node* l, AST_Node* r);
-        AST_Node(AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r);
-
-        /* Public methods for pretty printing */
-        void setPrintType(string s);
-        virtual void printAST_Node(int indent);
-    protected:
-        /* Private methods for pretty printing */
-        void printIndent(int indent);
+        AST_Node(Arena& arena, AST_Node* p, AST_Node* c);
+        AST_Node(Arena& arena, AST_Node* p, AST_Node* l, AST_Node* r);
+        AST_Node(Arena& arena, AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r);
+
+        /* Public methods for pretty printing, with labels from the arena
+           that made the node. Printing walks the tree with an explicit
+           stack, so deep trees cannot overflow the C++ stack. */
+        void printAST_Node(int indent, const Arena& arena, ostream& out = cout);
+        void printAST_Node(int indent, const Arena& arena, Emitter& out);
 };
 
-/* A statement list node is derived from an AST node */
+/* Replaces the label of every node under root with to[label] */
+void relabel(AST_Node* root, const vector<uint32_t>& to);
+
+/* A statement list node is derived from an AST node, and prints as a list */
 class SL_Node : public AST_Node {
     public:
-        SL_Node(string terminal = "") : AST_Node(terminal) { }
-        SL_Node(AST_Node* p, AST_Node* c) : AST_Node(p, c) { }
-        SL_Node(AST_Node* p, AST_Node* l, AST_Node* r) : AST_Node(p, l, r) { }
-        SL_Node(AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) : AST_Node(p, l, m, r) { }
-        virtual void printAST_Node(int indent);
+        SL_Node(Arena& a, uint32_t label = s_empty) : AST_Node(a, label) { kind = n_list; }
+        SL_Node(Arena& a, AST_Node* p, AST_Node* c) : AST_Node(a, p, c) { kind = n_list; }
+        SL_Node(Arena& a, AST_Node* p, AST_Node* l, AST_Node* r) : AST_Node(a, p, l, r) { kind = n_list; }
+        SL_Node(Arena& a, AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) : AST_Node(a, p, l, m, r) { kind = n_list; }
 };
 
-/* A branch statement node is derived from an AST node */
+/* A branch statement node is derived from an AST node, and prints on several lines */
 class B_Node : public AST_Node {
     public:
-        B_Node(string terminal = "") : AST_Node(terminal) { }
-        B_Node(AST_Node* p, AST_Node* c) : AST_Node(p, c) { }
-        B_Node(AST_Node* p, AST_Node* l, AST_Node* r) : AST_Node(p, l, r) { }
-        B_Node(AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) : AST_Node(p, l, m, r) { }
-        virtual void printAST_Node(int indent);
-};
\ No newline at end of file
+        B_Node(Arena& a, uint32_t label = s_empty) : AST_Node(a, label) { kind = n_branch; }
+        B_Node(Arena& a, AST_Node* p, AST_Node* c) : AST_Node(a, p, c) { kind = n_branch; }
+        B_Node(Arena& a, AST_Node* p, AST_Node* l, AST_Node* r) : AST_Node(a, p, l, r) { kind = n_branch; }
+        B_Node(Arena& a, AST_Node* p, AST_Node* l, AST_Node* m, AST_Node* r) : AST_Node(a, p, l, m, r) { kind = n_branch; }
+};
+
+/* Flat encoding of an AST: fixed-size records in one contiguous array, laid
+   out in pre-order so a node's first child immediately follows it. Labels
+   are stored once each in a side table. */
+const uint32_t FLAT_NONE = UINT32_MAX;
+
+struct FlatNode {
+    NodeKind kind;
+    uint32_t label;        // index into FlatAST::labels
+    uint32_t first_child;  // FLAT_NONE for a leaf
+    uint32_t next_sibling; // FLAT_NONE for the last child
+};
+
+class FlatAST {
+    public:
+        vector <FlatNode> nodes; // nodes[0] is the root
+        vector <string_view> labels;
+
+        /* Lays out the tree under root, labelled from arena, in one pass */
+        FlatAST(const AST_Node* root, const Arena& arena);
+
+        /* Prints in the same format as AST_Node::printAST_Node(0) */
+        void print(ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/* Prints a binary AST file (binast.h) in the text format of the parse
+    command, so "astdump out.ast" after "parse --emit=bin out.ast" gives
+    what plain "parse" would have printed. With -c it only walks the tree
+    and prints the number of nodes, which times loading without printing.
+*/
+#include <iostream>
+#include "binast.h"
+
+/* Counts the nodes reachable from the root through the child ranges */
+static size_t walk(const BinaryAST& ast) {
+    vector <uint32_t> stack = {0};
+    size_t count = 0;
+    while (!stack.empty()) {
+        const BinaryNode& n = ast.node(stack.back());
+        stack.pop_back();
+        count++;
+        for (uint32_t c = 0; c < n.child_count; c++) {
+            stack.push_back(n.first_child + c);
+        }
+    }
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    bool count = argc == 3 && string(argv[1]) == "-c";
+    if (argc != 2 && !count) {
+        cerr << "Usage: astdump [-c] file.ast\n";
+        return 1;
+    }
+    const char* path = argv[argc - 1];
+    BinaryAST ast;
+    string why;
+    if (!ast.open(path, why)) {
+        cerr << path << ": " << why << "\n";
+        return 1;
+    }
+    if (count) {
+        cout << walk(ast) << " nodes\n";
+        return 0;
+    }
+    Emitter out(cout);
+    ast.print(out);
+    out.put("\n\n");
+    out.flush();
+    return 0;
+}
@@ -0,0 +1,264 @@
+/* Batch driver: parses many files at once.
+    Each file gets its own Parser, so threads share nothing but the queues
+    of work. File indices are dealt round-robin to one queue per thread; a
+    thread takes from the front of its own queue, in file order, and when
+    it runs dry steals from the back of another's, so a few large files
+    cannot leave the other threads idle. Results are printed by the main
+    thread in file order as soon as each one and all before it are done.
+*/
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include "batch.h"
+#include "binast.h"
+#include "cache.h"
+#include "native.h"
+#include "opt.h"
+#include "split.h"
+
+/* Compiles and runs a parsed program. An error is reported at the line and
+   column of the token responsible. */
+static bool run_program(const AST_Node* root, Parser& parser, const ParseOptions& options) {
+    RunError error;
+    bool compiled, ran;
+    if (options.native) {
+        string source;
+        NativeProgram program;
+        compiled = emit_native(root, parser.arena, source, error)
+            && program.load(source, options.cache != nullptr ? options.cache : native_cache_dir(), error);
+        ran = compiled && program.run(cin, parser.out, error);
+    } else {
+        Program program;
+        compiled = compile(root, parser.arena, program, error);
+        ran = compiled && program.run(cin, parser.out, error);
+    }
+    if (ran) return true;
+    parser.out << (compiled ? "Runtime error" : "Cannot run the program");
+    if (error.offset != NO_OFFSET) {
+        string_view source = parser.scanner.source().substr(0, error.offset);
+        size_t line_start = source.rfind('\n') + 1; // 0 if there is none
+        parser.out << " at line " << count(source.begin(), source.end(), '\n') + 1
+                   << ", column " << error.offset - line_start + 1;
+    }
+    parser.out << ": " << error.message << ".\n";
+    return false;
+}
+
+static bool parse_and_print(Parser& parser, const ParseOptions& options) {
+    ofstream diag_file;
+    optional <DiagnosticWriter> diagnostics;
+    if (options.diagnostics != nullptr) {
+        diag_file.open(options.diagnostics, ios::binary);
+        if (!diag_file) {
+            parser.out << "Could not write " << options.diagnostics << ".\n";
+            return false;
+        }
+        diagnostics.emplace(diag_file, options.diag_format, parser.scanner.source());
+        parser.diagnostics = &*diagnostics;
+        parser.scanner.listener = &*diagnostics;
+    }
+    optional <Emitter> stream;
+    if (options.stream && options.split <= 1 && options.binary == nullptr) {
+        stream.emplace(parser.out);
+        parser.stream = &*stream;
+    }
+    /* The repair search simulates the table engine's stack */
+    bool table = options.table || options.repair;
+    parser.cost_repair = options.repair;
+    {
+        PhaseTimer timer(parser.stats, ph_read);
+        parser.scanner.source();
+    }
+    AST_Node* p;
+    {
+        PhaseTimer timer(parser.stats, ph_parse);
+        if (options.split > 1) {
+            p = split_program(parser, options.split, table);
+        } else {
+            if (options.pipeline) parser.scanner.startPipeline();
+            parser.input_token = parser.scanner.scan ();
+            p = table ? parser.table_program() : parser.program();
+        }
+    }
+    if (parser.stopped()) {
+        return false;
+    }
+    if (options.optimize && !parser.error) {
+        p = optimize(p, parser.arena, options.share);
+    }
+    if (options.run && !parser.error) {
+        return run_program(p, parser, options);
+    }
+    PhaseTimer timer(parser.stats, ph_print);
+    if (!parser.error && options.binary != nullptr) {
+        if (!writeBinaryAST(p, parser.arena, options.binary)) {
+            parser.out << "Could not write " << options.binary << ".\n";
+            return false;
+        }
+        return true;
+    } else if (!parser.error && parser.stream != nullptr && p->label == s_program) {
+        /* A source that cannot start a program is a lone ERROR, with
+           nothing streamed; it prints as a tree */
+        parser.finishStream();
+    } else if (!parser.error && options.flat) {
+        FlatAST(p, parser.arena).print(parser.out);
+    } else if (!parser.error) {
+        p->printAST_Node(0, parser.arena, parser.out);
+    } else {
+        parser.input.print(parser.out, parser.scanner.source());
+    }
+    parser.out << "\n\n";
+    return !(options.run && parser.error);
+}
+
+bool run_parse(Parser& parser, const ParseOptions& options) {
+    parser.stats.timing = options.stats;
+    bool ok = parse_and_print(parser, options);
+    parser.stats.parses++;
+    for (int k = 0; k < 3; k++) {
+        parser.stats.nodes[k] = parser.arena.nodeCount(NodeKind(k));
+    }
+    publish_stats(parser.stats);
+    return ok;
+}
+
+/* Names every option that changes what a parse prints, so that outputs
+   printed differently are cached apart: the engine (the table engine
+   recovers in its own way), the flat printer, streaming (a partial tree
+   before the diagnostics), cost repair, and simplification with or
+   without sharing. -j and --pipeline print what the serial parse does. */
+static string cache_variant(const ParseOptions& options) {
+    string variant;
+    if (options.table) variant += "-table";
+    if (options.flat) variant += "-flat";
+    if (options.stream) variant += "-stream";
+    if (options.repair) variant += "-repair";
+    if (options.optimize) variant += options.share ? "-opt=share" : "-opt";
+    return variant;
+}
+
+bool parse_file(const char* path, ostream& out, const ParseOptions& options) {
+    bool cached = options.cache != nullptr && options.binary == nullptr && options.diagnostics == nullptr
+                  && !options.run;
+    ostringstream captured;
+    Parser parser(cached ? captured : out);
+    parser.stats.timing = options.stats;
+    bool mapped;
+    {
+        PhaseTimer timer(parser.stats, ph_read);
+        mapped = path == nullptr || parser.scanner.mapFile(path);
+    }
+    if (!mapped) {
+        out << "Could not map " << path << ".\n";
+        return false;
+    }
+    if (!cached) {
+        return run_parse(parser, options);
+    }
+
+    string_view source = parser.scanner.source();
+    string key = cache_key(source, cache_variant(options));
+    string output;
+    bool ok;
+    if (cache_load(options.cache, key, source.size(), output, ok)) {
+        out << output;
+        return ok;
+    }
+    ok = run_parse(parser, options);
+    output = captured.str();
+    cache_save(options.cache, key, source.size(), output, ok);
+    out << output;
+    return ok;
+}
+
+/* One thread's share of the files */
+struct WorkQueue {
+    mutex lock;
+    deque <size_t> files;
+};
+
+struct Result {
+    string output;
+    bool ok = false;
+    bool done = false;
+};
+
+/* Takes the next file for thread self: its own first, else a stolen one.
+   Returns false when every queue is empty; no work is added once started. */
+static bool take(vector <WorkQueue>& queues, size_t self, size_t& file) {
+    for (size_t k = 0; k < queues.size(); k++) {
+        WorkQueue& q = queues[(self + k) % queues.size()];
+        lock_guard <mutex> guard(q.lock);
+        if (q.files.empty()) continue;
+        if (k == 0) {
+            file = q.files.front();
+            q.files.pop_front();
+        } else {
+            file = q.files.back();
+            q.files.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+int run_batch(const string& dir, int jobs, const ParseOptions& options) {
+    vector <string> paths;
+    error_code failed;
+    for (const auto& entry : filesystem::directory_iterator(dir, failed)) {
+        if (entry.is_regular_file()) paths.push_back(entry.path().string());
+    }
+    if (failed) {
+        cout << "Could not read directory " << dir << ".\n";
+        return 1;
+    }
+    sort(paths.begin(), paths.end());
+
+    if (jobs < 1) jobs = 1;
+    vector <WorkQueue> queues(jobs);
+    for (size_t i = 0; i < paths.size(); i++) {
+        queues[i % jobs].files.push_back(i);
+    }
+    vector <Result> results(paths.size());
+    mutex results_lock;
+    condition_variable finished;
+
+    auto work = [&](size_t self) {
+        size_t i;
+        while (take(queues, self, i)) {
+            ostringstream out;
+            bool ok = parse_file(paths[i].c_str(), out, options);
+            lock_guard <mutex> guard(results_lock);
+            results[i].output = out.str();
+            results[i].ok = ok;
+            results[i].done = true;
+            finished.notify_one();
+        }
+    };
+    vector <thread> threads;
+    for (int t = 0; t < jobs; t++) {
+        threads.emplace_back(work, t);
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        string output;
+        {
+            unique_lock <mutex> guard(results_lock);
+            finished.wait(guard, [&] { return results[i].done; });
+            output.swap(results[i].output);
+            if (!results[i].ok) status = 1;
+        }
+        cout << "==> " << paths[i] << " <==\n" << output;
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    return status;
+}
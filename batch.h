@@ -0,0 +1,49 @@
+/* Parsing whole files, alone or a directory of them on a pool of threads */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "diag.h"
+#include "parse.h"
+
+struct ParseOptions {
+    bool table = false; // use the table-driven engine
+    bool flat = false;  // print through the flat encoding
+    int split = 0;      // if above 1, parse in chunks on this many threads
+    bool pipeline = false; // scan on a thread of its own, ahead of the parser
+    bool stream = false;   // print top-level statements as they are parsed
+    const char* binary = nullptr; // if set, write the AST here (binast.h) instead of printing it
+    const char* cache = nullptr;  // if set, directory of cached results (cache.h)
+    const char* diagnostics = nullptr; // if set, file to record diagnostics in (diag.h)
+    DiagFormat diag_format = f_jsonl;
+    bool repair = false; // repair errors by cost search (table engine only)
+    bool stats = false;  // time the phases of each parse (stats.h)
+    bool optimize = false; // simplify the tree before it is written (opt.h)
+    bool share = false;    // and share identical expressions
+    bool run = false;      // run the program instead of printing it (vm.h)
+    bool native = false;   // and run it as compiled C++ (native.h)
+};
+
+/* Parses the source given to parser.scanner and prints the AST, or the
+   syntax errors and the repaired input, on parser.out. With options.run, a
+   program without errors is run instead, reading from cin and writing to
+   parser.out; with options.native too, its object is cached in
+   options.cache if that is set. Returns false if a fatal error ended the
+   parse, the binary AST or diagnostics file could not be written, or the
+   program had syntax errors or stopped on a runtime error. The parse's
+   counters are added to the process totals (collected_stats() in
+   stats.h). */
+bool run_parse(Parser& parser, const ParseOptions& options);
+
+/* Parses the file at path, or stdin if path is null, with run_parse on a
+   Parser of its own, printing on out. With options.cache, a source parsed
+   before is answered from the cache without parsing, and a new one is
+   saved there. Returns false if the file cannot be mapped or run_parse
+   returns false. */
+bool parse_file(const char* path, ostream& out, const ParseOptions& options);
+
+/* Parses every regular file in dir, in name order, on jobs threads, and
+   prints each file's result under a "==> name <==" header in that order.
+   Returns 0 if every file was read and parsed to the end, 1 otherwise. */
+int run_batch(const string& dir, int jobs, const ParseOptions& options);
+
+#endif
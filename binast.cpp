@@ -0,0 +1,145 @@
+/* Binary AST writer and mapped reader; see binast.h */
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "binast.h"
+#include "printtree.h"
+
+/* Numbers the nodes breadth-first: a node's children are numbered together
+   when it is reached, so they get consecutive indices. Only the symbols the
+   tree uses are written, numbered in order of first use. */
+bool writeBinaryAST(const AST_Node* root, const Arena& arena, const char* path) {
+    vector <const AST_Node*> order = {root};
+    vector <BinaryNode> nodes;
+    vector <uint32_t> label_index(arena.symbolCount(), UINT32_MAX);
+    vector <uint32_t> label_start = {0};
+    string text;
+    for (size_t i = 0; i < order.size(); i++) {
+        const AST_Node* n = order[i];
+        uint32_t& label = label_index[n->label];
+        if (label == UINT32_MAX) {
+            label = label_start.size() - 1;
+            text.append(arena.label(n->label));
+            label_start.push_back(text.size());
+        }
+        nodes.push_back({n->kind, {0, 0, 0}, label, uint32_t(order.size()),
+                         uint32_t(n->children.size()), n->offset});
+        for (AST_Node* c : n->children) {
+            order.push_back(c);
+        }
+    }
+
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_AST_MAGIC, 4);
+    header.version = BINARY_AST_VERSION;
+    header.node_count = nodes.size();
+    header.label_count = label_start.size() - 1;
+    header.label_bytes = text.size();
+
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(nodes.data(), sizeof(BinaryNode), nodes.size(), f) == nodes.size()
+        && fwrite(label_start.data(), sizeof(uint32_t), label_start.size(), f) == label_start.size()
+        && fwrite(text.data(), 1, text.size(), f) == text.size();
+    return fclose(f) == 0 && ok;
+}
+
+BinaryAST::~BinaryAST() {
+    if (data != nullptr) munmap(data, length);
+}
+
+bool BinaryAST::open(const char* path, string& why) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        why = "cannot open file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(BinaryHeader)) {
+        close(fd);
+        why = "too short for a header";
+        return false;
+    }
+    length = st.st_size;
+    data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        data = nullptr;
+        why = "cannot map file";
+        return false;
+    }
+
+    const char* base = (const char*) data;
+    header = (const BinaryHeader*) base;
+    if (memcmp(header->magic, BINARY_AST_MAGIC, 4) != 0) {
+        why = "not a binary AST";
+        return false;
+    }
+    if (header->version != BINARY_AST_VERSION) {
+        why = "version " + to_string(header->version) + ", expected " + to_string(BINARY_AST_VERSION);
+        return false;
+    }
+    uint64_t needed = sizeof(BinaryHeader) + uint64_t(header->node_count) * sizeof(BinaryNode)
+        + (uint64_t(header->label_count) + 1) * sizeof(uint32_t);
+    if (header->node_count == 0 || header->label_bytes > length || needed + header->label_bytes != length) {
+        why = "table sizes do not match the file";
+        return false;
+    }
+    nodes = (const BinaryNode*) (base + sizeof(BinaryHeader));
+    label_start = (const uint32_t*) (nodes + header->node_count);
+    text = (const char*) (label_start + header->label_count + 1);
+    return check(why);
+}
+
+/* Checks every index the records hold, so that walking the tree stays
+   inside the mapping. Children come after their parent, as the writer
+   numbers them breadth-first, so a damaged file cannot make a cycle. */
+bool BinaryAST::check(string& why) const {
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const BinaryNode& n = nodes[i];
+        if (n.kind > n_branch) {
+            why = "node " + to_string(i) + " has an unknown kind";
+            return false;
+        }
+        if (n.label >= header->label_count) {
+            why = "node " + to_string(i) + " has a label index past the label table";
+            return false;
+        }
+        if (n.first_child <= i || uint64_t(n.first_child) + n.child_count > header->node_count) {
+            why = "node " + to_string(i) + " has children outside the node table";
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->label_count; i++) {
+        if (label_start[i] > label_start[i + 1]) {
+            why = "label " + to_string(i) + " ends before it starts";
+            return false;
+        }
+    }
+    if (label_start[header->label_count] > header->label_bytes) {
+        why = "the label table runs past the label text";
+        return false;
+    }
+    return true;
+}
+
+/* Mapped records as seen by printTree: a cursor is the index of the child */
+struct BinaryTree {
+    const BinaryAST& ast;
+    typedef uint32_t Node;
+    typedef uint32_t Cursor;
+    NodeKind kind(Node n) const { return ast.node(n).kind; }
+    string_view label(Node n) const { return ast.label(ast.node(n).label); }
+    Cursor first(Node n) const { return ast.node(n).first_child; }
+    bool done(Node n, Cursor c) const { return c == ast.node(n).first_child + ast.node(n).child_count; }
+    Node child(Node n, Cursor c) const { return c; }
+    Cursor next(Node n, Cursor c) const { return c + 1; }
+};
+
+void BinaryAST::print(Emitter& out) const {
+    printTree(out, BinaryTree {*this}, 0, 0);
+}
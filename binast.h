@@ -0,0 +1,79 @@
+/* Binary serialization of an AST.
+
+    The file is the tree laid out breadth-first, so the children of every
+    node are one contiguous range of records, followed by the label table.
+    Everything is in native byte order, at offsets fixed by the header, so
+    a reader maps the file and walks the records in place.
+
+        BinaryHeader
+        BinaryNode nodes[node_count]       nodes[0] is the root
+        uint32_t label_start[label_count + 1]
+        char label_text[]                  label i is label_text[label_start[i]
+                                           .. label_start[i + 1]]
+*/
+#ifndef BINAST_H
+#define BINAST_H
+
+#include "ast.h"
+
+const char BINARY_AST_MAGIC[4] = {'C', 'A', 'S', 'T'};
+const uint32_t BINARY_AST_VERSION = 1;
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t label_count;
+    uint64_t label_bytes;
+};
+
+struct BinaryNode {
+    NodeKind kind;
+    uint8_t unused[3];
+    uint32_t label;       // index into the label table
+    uint32_t first_child; // index of the first child; children are consecutive
+    uint32_t child_count;
+    uint32_t offset;      // source offset, or NO_OFFSET
+};
+
+static_assert(sizeof(BinaryHeader) == 24 && sizeof(BinaryNode) == 20,
+              "binary AST records have a fixed layout");
+
+/* Writes the tree under root, labelled from arena, to path. Returns false
+   if it cannot be written. */
+bool writeBinaryAST(const AST_Node* root, const Arena& arena, const char* path);
+
+/* A binary AST file mapped read-only into memory */
+class BinaryAST {
+    public:
+        BinaryAST() { }
+        ~BinaryAST();
+        BinaryAST(const BinaryAST&) = delete;
+        BinaryAST& operator=(const BinaryAST&) = delete;
+
+        /* Maps the file and checks its header, its table sizes and every
+           child range, label index and label offset in it. Returns false,
+           with a message in why, if it is not a sound binary AST of this
+           version. */
+        bool open(const char* path, string& why);
+
+        uint32_t size() const { return header->node_count; }
+        const BinaryNode& node(uint32_t i) const { return nodes[i]; }
+        string_view label(uint32_t i) const {
+            return string_view(text + label_start[i], label_start[i + 1] - label_start[i]);
+        }
+
+        /* Prints in the same format as AST_Node::printAST_Node(0) */
+        void print(Emitter& out) const;
+    private:
+        void* data = nullptr;
+        size_t length = 0;
+        const BinaryHeader* header = nullptr;
+        const BinaryNode* nodes = nullptr;
+        const uint32_t* label_start = nullptr;
+        const char* text = nullptr;
+
+        bool check(string& why) const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/* Parse cache; see cache.h.
+    An entry file is the length of the source (8 bytes, native order), a
+    byte that is 1 if the parse ended normally, and then the output.
+*/
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <functional>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "cache.h"
+#include "parse.h"
+
+static const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t P3 = 0x165667B19E3779F9ULL;
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t mix(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * P2, 31) * P1;
+}
+
+/* Four independent lanes over 32-byte stripes, so the multiplies overlap,
+   then the tail a word and a byte at a time */
+uint64_t hash_bytes(string_view data) {
+    const char* p = data.data();
+    const char* end = p + data.size();
+    uint64_t lane[4] = {P1 + P2, P2, 0, 0 - P1};
+    while (end - p >= 32) {
+        for (int k = 0; k < 4; k++) {
+            lane[k] = mix(lane[k], read64(p + 8 * k));
+        }
+        p += 32;
+    }
+    uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+    h += data.size();
+    for (; end - p >= 8; p += 8) {
+        h = rotl(h ^ mix(0, read64(p)), 27) * P1 + P3;
+    }
+    for (; p < end; p++) {
+        h = rotl(h ^ ((unsigned char) *p * P3), 11) * P1;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+string cache_key(string_view source, const string& variant) {
+    char hex[17];
+    snprintf(hex, sizeof hex, "%016llx", (unsigned long long) hash_bytes(source));
+    return "v" + to_string(PARSER_VERSION) + "-" + hex + variant;
+}
+
+bool cache_load(const string& dir, const string& key, size_t source_length,
+                string& output, bool& ok) {
+    int fd = open((dir + "/" + key).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    const size_t header = sizeof(uint64_t) + 1;
+    if (fstat(fd, &st) < 0 || size_t(st.st_size) < header) {
+        close(fd);
+        return false;
+    }
+    string entry(st.st_size, '\0');
+    ssize_t got = read(fd, &entry[0], entry.size());
+    close(fd);
+    uint64_t length;
+    memcpy(&length, entry.data(), sizeof length);
+    if (got != ssize_t(entry.size()) || length != source_length || entry[8] > 1) {
+        return false;
+    }
+    ok = entry[8] == 1;
+    output.assign(entry, header, string::npos);
+    return true;
+}
+
+void cache_save(const string& dir, const string& key, size_t source_length,
+                const string& output, bool ok) {
+    error_code ignored;
+    filesystem::create_directories(dir, ignored);
+    string path = dir + "/" + key;
+    string temp = path + ".tmp" + to_string(getpid()) + "-"
+        + to_string(hash<thread::id>()(this_thread::get_id()));
+    FILE* f = fopen(temp.c_str(), "wb");
+    if (f == nullptr) return;
+    uint64_t length = source_length;
+    char status = ok;
+    bool written = fwrite(&length, sizeof length, 1, f) == 1
+        && fwrite(&status, 1, 1, f) == 1
+        && fwrite(output.data(), 1, output.size(), f) == output.size();
+    if (fclose(f) == 0 && written) {
+        rename(temp.c_str(), path.c_str());
+    } else {
+        remove(temp.c_str());
+    }
+}
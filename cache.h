@@ -0,0 +1,34 @@
+/* Content-addressed cache of parse results.
+    An entry holds everything a parse printed and whether it ended
+    normally. It is named by a hash of the source together with
+    PARSER_VERSION and the output variant, so a changed input, a new
+    parser or a different output mode simply misses.
+*/
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/* Fast non-cryptographic 64-bit hash, in the style of xxHash64 */
+uint64_t hash_bytes(string_view data);
+
+/* Name of the entry for source; variant tells apart output modes that can
+   print differently for the same source */
+string cache_key(string_view source, const string& variant);
+
+/* Reads the entry key from dir with a single read. Returns false on a miss,
+   or if the entry is damaged or was made from a source of another length. */
+bool cache_load(const string& dir, const string& key, size_t source_length,
+                string& output, bool& ok);
+
+/* Saves an entry, creating dir if needed. The entry is written to a temporary
+   file and renamed, so readers never see a partial one. Failures are ignored:
+   the cache only saves time. */
+void cache_save(const string& dir, const string& key, size_t source_length,
+                const string& output, bool ok);
+
+#endif
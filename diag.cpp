@@ -0,0 +1,132 @@
+/* Structured diagnostics; see diag.h */
+#include "diag.h"
+
+extern string names[];
+extern string nt_names[];
+
+static const char* kind_names[] = {"match", "recover", "scan", "repair"};
+static const char* repair_names[] = {"insert", "skip", "stop"};
+
+DiagnosticWriter::DiagnosticWriter(ostream& out, DiagFormat format, string_view source)
+    : emitter(out), format(format), source(source) {
+    if (format == f_binary) {
+        emitter.put(string_view(DIAG_MAGIC, 4));
+        emitter.put(string_view((const char*) &DIAG_VERSION, sizeof DIAG_VERSION));
+    }
+}
+
+/* Moves the line count to offset. Records come in source order but for
+   the rare one behind the last, which is counted again from the start. */
+void DiagnosticWriter::locate(size_t offset) {
+    if (offset > source.size()) offset = source.size();
+    if (offset < line_at) {
+        line_at = line_start = 0;
+        line = 1;
+    }
+    const char* base = source.data();
+    const char* p = base + line_at;
+    const char* end = base + offset;
+    while ((p = (const char*) memchr(p, '\n', end - p)) != nullptr) {
+        p++;
+        line++;
+        line_start = p - base;
+    }
+    line_at = offset;
+}
+
+void DiagnosticWriter::record(const Diagnostic& d) {
+    locate(d.offset);
+    if (format == f_jsonl) {
+        putJson(d);
+        return;
+    }
+    DiagRecord r = {d.kind, d.repair, uint8_t(d.during), uint8_t(d.received), uint8_t(d.inserted),
+                    d.resumed, {0, 0}, line, uint32_t(line_at - line_start + 1), d.offset,
+                    d.expected, d.skipped, uint32_t(d.text.size()), 0};
+    emitter.put(string_view((const char*) &r, sizeof r));
+    emitter.put(d.text);
+}
+
+void DiagnosticWriter::scanError(size_t offset, string_view text, bool fatal) {
+    Diagnostic d = {d_scan, fatal ? r_stop : r_skip};
+    d.offset = offset;
+    d.text = text;
+    record(d);
+}
+
+void DiagnosticWriter::putJson(const Diagnostic& d) {
+    emitter.put("{\"kind\":\"");
+    emitter.put(kind_names[d.kind]);
+    emitter.put("\",\"line\":");
+    putNumber(line);
+    emitter.put(",\"column\":");
+    putNumber(line_at - line_start + 1);
+    emitter.put(",\"offset\":");
+    putNumber(d.offset);
+    if (d.during != nt_null) {
+        emitter.put(",\"during\":\"");
+        emitter.put(nt_names[d.during]);
+        emitter.put('"');
+    }
+    if (d.kind != d_scan) {
+        emitter.put(",\"expected\":[");
+        bool first = true;
+        for (int t = 0; t < t_null; t++) {
+            if (!contains(d.expected, token(t))) continue;
+            if (!first) emitter.put(',');
+            putString(names[t]);
+            first = false;
+        }
+        emitter.put("],\"received\":");
+        putString(names[d.received]);
+    }
+    if (d.kind == d_scan || d.received == t_id || d.received == t_literal) {
+        emitter.put(",\"text\":");
+        putString(d.text);
+    }
+    emitter.put(",\"repair\":\"");
+    emitter.put(repair_names[d.repair]);
+    emitter.put('"');
+    if (d.repair == r_insert) {
+        emitter.put(",\"inserted\":");
+        putString(names[d.inserted]);
+    }
+    if (d.kind == d_recover || (d.kind == d_repair && d.repair == r_skip)) {
+        emitter.put(",\"skipped\":");
+        putNumber(d.skipped);
+    }
+    if (d.kind == d_recover) {
+        emitter.put(d.resumed ? ",\"resumed\":true" : ",\"resumed\":false");
+    }
+    emitter.put("}\n");
+}
+
+void DiagnosticWriter::putNumber(uint64_t n) {
+    char digits[20];
+    int i = sizeof digits;
+    do {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0);
+    emitter.put(string_view(digits + i, sizeof digits - i));
+}
+
+/* Writes s as a JSON string. Bytes outside ASCII are escaped one by one,
+   so text that is not UTF-8 still makes valid JSON. */
+void DiagnosticWriter::putString(string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    emitter.put('"');
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            emitter.put('\\');
+            emitter.put(char(c));
+        } else if (c < 0x20 || c >= 0x7f) {
+            emitter.put("\\u00");
+            emitter.put(hex[c >> 4]);
+            emitter.put(hex[c & 15]);
+        } else {
+            emitter.put(char(c));
+        }
+    }
+    emitter.put('"');
+}
@@ -0,0 +1,102 @@
+/* Structured diagnostics.
+    Every syntax and scan error of a parse can be recorded, next to the
+    English messages, as a record a tool can read without scraping text:
+    what went wrong, where, what was expected and received, and how the
+    parser repaired it. A record is written once its repair is done, so a
+    recover record follows any scan errors in the tokens it skipped.
+    Records are written as JSON Lines or as a compact binary stream,
+    through an Emitter, so many errors cost few writes.
+
+    Line and column are found from the byte offset only when a record is
+    written, by counting newlines forward from the previous record's
+    position, so the scanner tracks nothing but offsets.
+
+    The binary stream is a header (magic "CDIA", version) and then one
+    DiagRecord per diagnostic, each followed by text_length bytes of text,
+    in native byte order.
+*/
+#ifndef DIAG_H
+#define DIAG_H
+
+#include "grammar.h"
+
+enum DiagKind : uint8_t {
+    d_match,   // match() did not find the expected token
+    d_recover, // a subroutine could not start, and tokens were skipped
+    d_scan,    // text outside the language
+    d_repair   // one edit of a repair found by --repair=cost
+};
+
+enum DiagRepair : uint8_t {
+    r_insert, // the expected token was inserted
+    r_skip,   // received tokens, or the bad text, were skipped
+    r_stop    // the parse ended here
+};
+
+struct Diagnostic {
+    DiagKind kind;
+    DiagRepair repair;
+    nonterminal during = nt_null; // the subroutine recovering (d_recover)
+    token received = t_null;
+    token inserted = t_null;
+    bool resumed = false;         // d_recover: stopped at a token in FIRST, to run again
+    token_set expected = 0;
+    uint32_t skipped = 0;         // tokens skipped (d_recover)
+    size_t offset;
+    string_view text;             // received id or literal, or the bad text
+};
+
+enum DiagFormat {f_jsonl, f_binary};
+
+const char DIAG_MAGIC[4] = {'C', 'D', 'I', 'A'};
+const uint32_t DIAG_VERSION = 1;
+
+/* A record of the binary stream; enums are stored as bytes, t_null and
+   nt_null for none */
+struct DiagRecord {
+    uint8_t kind;
+    uint8_t repair;
+    uint8_t during;
+    uint8_t received;
+    uint8_t inserted;
+    uint8_t resumed;
+    uint8_t unused[2];
+    uint32_t line;   // from 1
+    uint32_t column; // in bytes, from 1
+    uint64_t offset;
+    uint32_t expected;
+    uint32_t skipped;
+    uint32_t text_length;
+    uint32_t unused2;
+};
+
+static_assert(sizeof(DiagRecord) == 40, "diagnostic records have a fixed layout");
+
+class DiagnosticWriter : public ScanErrorListener {
+    public:
+        /* Writes records for a parse of source on out */
+        DiagnosticWriter(ostream& out, DiagFormat format, string_view source);
+        DiagnosticWriter(const DiagnosticWriter&) = delete;
+        DiagnosticWriter& operator=(const DiagnosticWriter&) = delete;
+
+        void record(const Diagnostic& d);
+        void scanError(size_t offset, string_view text, bool fatal) override;
+        /* Writes out the records buffered so far */
+        void flush() { emitter.flush(); }
+    private:
+        Emitter emitter;
+        DiagFormat format;
+        string_view source;
+        /* The position of the last record: line is the line of offset
+           line_at, which starts at offset line_start */
+        size_t line_at = 0;
+        size_t line_start = 0;
+        uint32_t line = 1;
+
+        void locate(size_t offset);
+        void putJson(const Diagnostic& d);
+        void putNumber(uint64_t n);
+        void putString(string_view s);
+};
+
+#endif
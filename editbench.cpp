@@ -0,0 +1,240 @@
+/* Replays an edit trace against a Document (reparse.h) and reports the
+    latency of each incremental reparse.
+
+    Usage: editbench [-c] file [trace]
+
+    Each line of a trace is "offset removed text": remove that many bytes at
+    offset and insert the rest of the line, in which \n stands for a newline.
+    Without a trace, 2000 edits are made up that type a digit over another
+    digit, and that insert a statement at the start of a line and delete it
+    again. The last one leaves a " +" after a top-level statement that
+    another one follows, which then takes that statement's first token as
+    its operand. A second trace then types a statement and a while block a
+    character at a time, inside the innermost block and at the top level,
+    and deletes them again, so most of its edits leave a syntax error.
+
+    At the end of each trace, whether the text has errors, and if not its
+    tree, are checked against a full parse; with -c, after every edit.
+*/
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "reparse.h"
+
+struct Edit {
+    size_t offset;
+    size_t removed;
+    string inserted;
+};
+
+static vector <Edit> read_trace(const char* path) {
+    vector <Edit> edits;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        Edit e;
+        if (!(fields >> e.offset >> e.removed)) continue;
+        string rest;
+        getline(fields, rest);
+        if (!rest.empty() && rest[0] == ' ') rest.erase(0, 1);
+        for (size_t i = 0; i < rest.size(); i++) {
+            if (rest[i] == '\\' && i + 1 < rest.size() && rest[i + 1] == 'n') {
+                e.inserted += '\n';
+                i++;
+            } else {
+                e.inserted += rest[i];
+            }
+        }
+        edits.push_back(e);
+    }
+    return edits;
+}
+
+/* Offsets just past each top-level statement that another one follows */
+static vector <size_t> statement_ends(const string& text) {
+    vector <size_t> ends;
+    ostringstream discard;
+    Scanner scanner(discard);
+    scanner.errors_fatal = false;
+    scanner.setSource(text.data(), text.size());
+    long depth = 0;
+    token prev = t_null;
+    size_t end = 0, before_prev = 0; // ends of the last two tokens
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        if (depth == 0 && (t == t_read || t == t_write || t == t_if || t == t_while) && end > 0) {
+            ends.push_back(end);
+        } else if (depth == 0 && t == t_gets && prev == t_id && before_prev > 0) {
+            ends.push_back(before_prev);
+        }
+        if (t == t_if || t == t_while) depth++;
+        else if (t == t_end && depth > 0) depth--;
+        prev = t;
+        before_prev = end;
+        end = scanner.token_offset + scanner.token_image.size();
+    }
+    return ends;
+}
+
+static vector <Edit> make_trace(const string& text, int count) {
+    vector <size_t> digits, lines;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (isdigit((unsigned char) text[i])) digits.push_back(i);
+        if (i == 0 || text[i - 1] == '\n') lines.push_back(i);
+    }
+    mt19937 rng(1);
+    vector <Edit> edits;
+    while (int(edits.size()) < count) {
+        if (!digits.empty() && rng() % 4 != 0) {
+            edits.push_back({digits[rng() % digits.size()], 1, string(1, char('0' + rng() % 10))});
+        } else {
+            size_t at = lines[rng() % lines.size()];
+            string statement = "x := 1\n";
+            edits.push_back({at, 0, statement});
+            edits.push_back({at, statement.size(), ""});
+        }
+    }
+    vector <size_t> ends = statement_ends(text);
+    if (!ends.empty()) {
+        edits.push_back({ends[rng() % ends.size()], 0, " +"});
+    }
+    return edits;
+}
+
+/* Offsets just past a simple statement that another one follows in the
+   same block, with the number of blocks around them */
+static vector <pair <size_t, int>> line_ends(const string& text) {
+    vector <pair <size_t, int>> ends;
+    ostringstream discard;
+    Scanner scanner(discard);
+    scanner.errors_fatal = false;
+    scanner.setSource(text.data(), text.size());
+    vector <bool> seen(1, false); // a statement seen in each open block
+    token prev = t_null, before_prev = t_null;
+    size_t end = 0, before_end = 0; // ends of the last two tokens
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        int depth = int(seen.size()) - 1;
+        bool starts = t == t_read || t == t_write || t == t_if || t == t_while;
+        size_t at = end;
+        token last = prev;
+        if (t == t_gets && prev == t_id) {
+            starts = true;
+            at = before_end;
+            last = before_prev;
+        }
+        if (starts) {
+            if (seen.back() && last != t_end) ends.push_back({at, depth});
+            seen.back() = true;
+        }
+        if (t == t_if || t == t_while) seen.push_back(false);
+        else if (t == t_end && seen.size() > 1) seen.pop_back();
+        before_prev = prev;
+        prev = t;
+        before_end = end;
+        end = scanner.token_offset + scanner.token_image.size();
+    }
+    return ends;
+}
+
+/* Types a statement and then a block one character at a time after a
+   statement in the innermost block, and again at the top level, and
+   deletes each one a character at a time. Most of the keystrokes leave a
+   syntax error. */
+static vector <Edit> make_typing(const string& text) {
+    vector <pair <size_t, int>> ends = line_ends(text);
+    vector <size_t> places;
+    if (!ends.empty()) {
+        auto deepest = max_element(ends.begin(), ends.end(), [](auto& a, auto& b) { return a.second < b.second; });
+        places.push_back(deepest->first);
+        if (deepest->second > 0) {
+            auto outer = find_if(ends.rbegin(), ends.rend(), [](auto& e) { return e.second == 0; });
+            if (outer != ends.rend()) places.push_back(outer->first);
+        }
+    }
+    places.push_back(text.size());
+    vector <Edit> edits;
+    for (size_t at : places) {
+        for (string typed : {"\n t := t + 1", "\n while t < 10\n if t > 5\n t := t * 2\n end\n t := t + 1\n end"}) {
+            for (size_t i = 0; i < typed.size(); i++) {
+                edits.push_back({at + i, 0, typed.substr(i, 1)});
+            }
+            for (size_t i = typed.size(); i > 0; i--) {
+                edits.push_back({at + i - 1, 1, ""});
+            }
+        }
+    }
+    return edits;
+}
+
+static string print(Document& doc) {
+    ostringstream out;
+    AST_Node* root = doc.root();
+    if (root) root->printAST_Node(0, doc.arena(), out);
+    return out.str();
+}
+
+/* True if doc has the errors, or the tree, of a full parse of its text */
+static bool matches_full_parse(Document& doc) {
+    Document full(doc.text());
+    return doc.hasErrors() == full.hasErrors() && (doc.hasErrors() || print(doc) == print(full));
+}
+
+/* Replays edits on a Document of text and reports their latencies. With
+   check, every edit is checked against a full parse, outside the timing. */
+static bool replay(const char* name, const string& text, const vector <Edit>& edits, bool check) {
+    Document doc(text);
+    vector <double> times;
+    size_t reparsed = 0;
+    size_t errors = 0;
+    for (size_t i = 0; i < edits.size(); i++) {
+        const Edit& e = edits[i];
+        auto start = chrono::steady_clock::now();
+        doc.edit(e.offset, e.removed, e.inserted);
+        times.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        reparsed += doc.lastReparsed();
+        errors += doc.hasErrors();
+        if (check && !matches_full_parse(doc)) {
+            cout << "  " << name << ": edit " << i << " does not match a full parse\n";
+            return false;
+        }
+    }
+    sort(times.begin(), times.end());
+    bool same = matches_full_parse(doc);
+
+    cout << "  " << name << ": " << edits.size() << " edits, " << errors << " leaving syntax errors\n";
+    if (!times.empty()) {
+        cout << "    median " << times[times.size() / 2] << " us, p99 " << times[times.size() * 99 / 100]
+             << " us, max " << times.back() << " us, "
+             << double(reparsed) / times.size() << " statements reparsed per edit\n";
+    }
+    cout << "    tree matches a full parse: " << (same ? "yes" : "NO") << "\n";
+    return same;
+}
+
+int main(int argc, char* argv[]) {
+    bool check = argc > 1 && string(argv[1]) == "-c";
+    if (check) {
+        argc--;
+        argv++;
+    }
+    if (argc < 2) {
+        cerr << "Usage: editbench [-c] file [trace]\n";
+        return 1;
+    }
+    ifstream in(argv[1], ios::binary);
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    Document doc(text);
+    cout << argv[1] << ": " << doc.size() << " bytes, " << doc.statementCount() << " statements\n";
+    bool ok;
+    if (argc > 2) {
+        ok = replay("trace", text, read_trace(argv[2]), check);
+    } else {
+        ok = replay("random edits", text, make_trace(text, 2000), check);
+        ok = replay("typing", text, make_typing(text), check) && ok;
+    }
+    return ok ? 0 : 1;
+}
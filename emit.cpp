@@ -0,0 +1,44 @@
+/* Buffered output for printing trees; see emit.h */
+#include "emit.h"
+
+static const int SPACES = 64;
+static const char spaces[SPACES + 1] = "                                                                ";
+static const size_t FIRST_SIZE = 4096;
+
+Emitter::Emitter(ostream& out, size_t capacity)
+    : out(out), buffer(min(capacity, FIRST_SIZE)), capacity(capacity) {
+}
+
+void Emitter::indent(int n) {
+    while (n > 0) {
+        int k = n < SPACES ? n : SPACES;
+        put(string_view(spaces, k));
+        n -= k;
+    }
+}
+
+void Emitter::flush() {
+    if (used > 0) out.write(buffer.data(), used);
+    used = 0;
+}
+
+/* Grows the buffer toward capacity until n more bytes fit; flushes once it
+   cannot grow */
+void Emitter::makeRoom(size_t n) {
+    while (n > buffer.size() - used && buffer.size() < capacity) {
+        buffer.resize(min(buffer.size() * 2, capacity));
+    }
+    if (n > buffer.size() - used) flush();
+}
+
+/* A fragment that does not fit: make room, then buffer it or, if it is
+   bigger than the whole buffer, write it straight through */
+void Emitter::putLarge(string_view s) {
+    makeRoom(s.size());
+    if (s.size() > buffer.size() - used) {
+        out.write(s.data(), s.size());
+    } else {
+        memcpy(buffer.data() + used, s.data(), s.size());
+        used += s.size();
+    }
+}
@@ -0,0 +1,50 @@
+/* Buffered output for printing trees */
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/* Collects output fragments in one large buffer and hands the buffer to
+   the stream with a single write when it fills, or on flush(). The buffer
+   starts small and doubles up to capacity, so a short tree costs no more
+   than it prints. Indents are copied in blocks from a run of spaces
+   instead of written a column at a time. */
+class Emitter {
+    public:
+        Emitter(ostream& out, size_t capacity = 1 << 20);
+        ~Emitter() { flush(); }
+        Emitter(const Emitter&) = delete;
+        Emitter& operator=(const Emitter&) = delete;
+
+        void put(string_view s) {
+            if (s.size() > buffer.size() - used) {
+                putLarge(s);
+                return;
+            }
+            memcpy(buffer.data() + used, s.data(), s.size());
+            used += s.size();
+        }
+        void put(char c) {
+            if (used == buffer.size()) makeRoom(1);
+            buffer[used++] = c;
+        }
+        /* Writes n spaces */
+        void indent(int n);
+        /* Writes out everything buffered so far */
+        void flush();
+    private:
+        ostream& out;
+        vector <char> buffer;
+        size_t capacity;
+        size_t used = 0;
+
+        void makeRoom(size_t n);
+        void putLarge(string_view s);
+};
+
+#endif
@@ -0,0 +1,163 @@
+/* Generates random calculator programs for benchmarking the scanner and
+    parser. Programs are written to stdout, one statement per line.
+
+    Usage: gen [-n statements] [-l terms] [-d depth] [-i width] [-e error_rate] [-s seed]
+
+    With -l, every expression has exactly that many terms, so -n 1 -l 1000000
+    writes one very long a + b + c ... chain.
+
+    if and while blocks nest at most 3 deep, and only by chance. With -d,
+    every top-level if or while nests exactly that deep: the first statement
+    of each block is another block until the depth is reached, and the
+    others are simple statements, as in ex2.txt but as deep as asked.
+
+    With -i, the lines of a block are indented width spaces more than the
+    block, so most of the text is white space, as in ex2.txt.
+
+    With -e, each token is independently dropped, duplicated or replaced by
+    a random token with the given probability, giving error-dense input
+    for the recovery paths.
+*/
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static mt19937 rng;
+static long expr_terms = 0; /* 0 for a random length */
+static int max_depth = 3;
+static bool exact_depth = false;
+static int indent_width = 0;
+
+static const char* variables[] = {"a", "b", "c", "n", "sum", "cp", "found", "x1"};
+static const char* any_token[] = {"read", "write", "if", "while", "end", ":=", "+", "-",
+                                  "*", "/", "(", ")", "=", "<>", "<", ">", "<=", ">=",
+                                  "a", "n", "1", "42"};
+
+static int uniform(int n) {
+    return uniform_int_distribution<int>(0, n - 1)(rng);
+}
+
+static bool chance(double p) {
+    return uniform_real_distribution<double>(0, 1)(rng) < p;
+}
+
+static void gen_factor(vector <string>& out, int depth);
+
+static void gen_expr(vector <string>& out, int depth) {
+    long terms = expr_terms > 0 && depth == 0 ? expr_terms : 1 + uniform(3);
+    for (long i = 0; i < terms; i++) {
+        if (i > 0) out.push_back(chance(0.5) ? "+" : "-");
+        gen_factor(out, depth);
+        if (chance(0.3)) {
+            out.push_back(chance(0.5) ? "*" : "/");
+            gen_factor(out, depth);
+        }
+    }
+}
+
+static void gen_factor(vector <string>& out, int depth) {
+    if (depth < 2 && chance(0.15)) {
+        out.push_back("(");
+        gen_expr(out, depth + 1);
+        out.push_back(")");
+    } else if (chance(0.5)) {
+        out.push_back(variables[uniform(8)]);
+    } else {
+        out.push_back(to_string(uniform(100)));
+    }
+}
+
+/* first is true for the first statement of a block */
+static void gen_stmt(vector <string>& out, int depth, bool first = false) {
+    static const char* relations[] = {"=", "<>", "<", ">", "<=", ">="};
+    int kind = uniform(10);
+    if (exact_depth && depth > 0) {
+        /* Only the first statement nests, so the program stays linear in
+           the depth */
+        kind = first ? uniform(2) : 2 + uniform(8);
+    }
+    if (depth < max_depth && kind < 2) {
+        out.push_back(kind == 0 ? "if" : "while");
+        gen_expr(out, 0);
+        out.push_back(relations[uniform(6)]);
+        gen_expr(out, 0);
+        int n = 1 + uniform(4);
+        for (int i = 0; i < n; i++) {
+            out.push_back("\n");
+            gen_stmt(out, depth + 1, i == 0);
+        }
+        out.push_back("\n");
+        out.push_back("end");
+    } else if (kind < 4) {
+        out.push_back("read");
+        out.push_back(variables[uniform(8)]);
+    } else if (kind < 6) {
+        out.push_back("write");
+        gen_expr(out, 0);
+    } else {
+        out.push_back(variables[uniform(8)]);
+        out.push_back(":=");
+        gen_expr(out, 0);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    long statements = 1000;
+    double error_rate = 0;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "-n") statements = atol(argv[i + 1]);
+        else if (arg == "-l") expr_terms = atol(argv[i + 1]);
+        else if (arg == "-d") { max_depth = atoi(argv[i + 1]); exact_depth = true; }
+        else if (arg == "-i") indent_width = atoi(argv[i + 1]);
+        else if (arg == "-e") error_rate = atof(argv[i + 1]);
+        else if (arg == "-s") seed = atoi(argv[i + 1]);
+        else {
+            cerr << "Usage: gen [-n statements] [-l terms] [-d depth] [-i width] [-e error_rate] [-s seed]\n";
+            return 1;
+        }
+    }
+    rng.seed(seed);
+
+    string text;
+    vector <string> tokens;
+    for (long s = 0; s < statements; s++) {
+        tokens.clear();
+        gen_stmt(tokens, 0);
+        int level = 0; /* blocks open */
+        for (size_t k = 0; k < tokens.size(); k++) {
+            const string& t = tokens[k];
+            if (text.size() > (1 << 20)) {
+                cout << text;
+                text.clear();
+            }
+            if (t == "if" || t == "while") level++;
+            if (t == "\n") {
+                /* An end is indented as its block's if or while */
+                if (k + 1 < tokens.size() && tokens[k + 1] == "end") level--;
+                text += "\n";
+                text.append(size_t(indent_width) * level, ' ');
+                continue;
+            }
+            if (error_rate > 0 && chance(error_rate)) {
+                int damage = uniform(3);
+                if (damage == 0) continue;                               /* drop */
+                if (damage == 1) text.append(t).append(" ");             /* duplicate */
+                else { text.append(any_token[uniform(22)]).append(" "); continue; } /* replace */
+            }
+            text.append(t).append(" ");
+        }
+        text += "\n";
+        if (text.size() > (1 << 20)) {
+            cout << text;
+            text.clear();
+        }
+    }
+    cout << text;
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* The calculator grammar as a compile-time table, and the FIRST and FOLLOW
+   sets derived from it. Sets are bitmasks over the token enum, so testing
+   membership is a single AND.
+*/
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstdint>
+#include "ast.h"
+
+/* A set of tokens: bit t is set if token t is a member */
+typedef uint32_t token_set;
+static_assert(t_null < 32, "token_set needs a bit per token");
+
+constexpr token_set bit(token t) { return token_set(1) << t; }
+
+constexpr bool contains(token_set s, token t) { return (s & bit(t)) != 0; }
+
+/* One production. The right-hand side ends at the first null Symbol;
+   an epsilon production is written {EPS}. */
+const int MAX_RHS = 5;
+
+struct Production {
+    nonterminal lhs;
+    Symbol rhs[MAX_RHS];
+};
+
+constexpr Production grammar[] = {
+    {P,  {SL, t_eof}},                      /* program -> stmt_list $$ */
+    {SL, {S, SL}},                          /* stmt_list -> stmt stmt_list */
+    {SL, {EPS}},                            /* stmt_list -> epsilon */
+    {S,  {t_id, t_gets, E}},                /* stmt -> id := expr */
+    {S,  {t_read, t_id}},                   /* stmt -> read id */
+    {S,  {t_write, E}},                     /* stmt -> write expr */
+    {S,  {t_if, C, SL, t_end}},             /* stmt -> if cond stmt_list end */
+    {S,  {t_while, C, SL, t_end}},          /* stmt -> while cond stmt_list end */
+    {C,  {E, ro, E}},                       /* cond -> expr ro expr */
+    {E,  {T, TT}},                          /* expr -> term term_tail */
+    {T,  {F, FT}},                          /* term -> factor factor_tail */
+    {F,  {t_lparen, E, t_rparen}},          /* factor -> ( expr ) */
+    {F,  {t_id}},                           /* factor -> id */
+    {F,  {t_literal}},                      /* factor -> lit */
+    {TT, {ao, T, TT}},                      /* term_tail -> ao term term_tail */
+    {TT, {EPS}},                            /* term_tail -> epsilon */
+    {FT, {mo, F, FT}},                      /* factor_tail -> mo factor factor_tail */
+    {FT, {EPS}},                            /* factor_tail -> epsilon */
+    {ro, {t_eq}}, {ro, {t_neq}}, {ro, {t_less}},
+    {ro, {t_great}}, {ro, {t_leq}}, {ro, {t_geq}},
+    {ao, {t_add}}, {ao, {t_sub}},
+    {mo, {t_mul}}, {mo, {t_div}},
+};
+
+const int N_PRODUCTIONS = sizeof(grammar) / sizeof(grammar[0]);
+
+/* FIRST and FOLLOW of every nonterminal, and which ones derive epsilon */
+struct GrammarSets {
+    token_set first[nt_null];
+    token_set follow[nt_null];
+    bool nullable[nt_null];
+};
+
+/* FIRST of the symbols rhs[from..]; *nullable is set if they all derive epsilon */
+constexpr token_set first_of(const GrammarSets& g, const Symbol* rhs, int from, bool* nullable) {
+    token_set s = 0;
+    for (int i = from; i < MAX_RHS && !rhs[i].isEpsilon(); i++) {
+        if (rhs[i].isTerminal()) {
+            *nullable = false;
+            return s | bit(rhs[i].c.c);
+        }
+        if (!rhs[i].isNonTerminal()) break;
+        s |= g.first[rhs[i].X.X];
+        if (!g.nullable[rhs[i].X.X]) {
+            *nullable = false;
+            return s;
+        }
+    }
+    *nullable = true;
+    return s;
+}
+
+/* Iterates the usual FIRST/FOLLOW equations to a fixed point */
+constexpr GrammarSets compute_sets() {
+    GrammarSets g {};
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const Production& p : grammar) {
+            bool nullable = false;
+            token_set s = first_of(g, p.rhs, 0, &nullable);
+            if ((g.first[p.lhs] | s) != g.first[p.lhs]) {
+                g.first[p.lhs] |= s;
+                changed = true;
+            }
+            if (nullable && !g.nullable[p.lhs]) {
+                g.nullable[p.lhs] = true;
+                changed = true;
+            }
+        }
+    }
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (const Production& p : grammar) {
+            for (int i = 0; i < MAX_RHS; i++) {
+                if (!p.rhs[i].isNonTerminal()) continue;
+                nonterminal X = p.rhs[i].X.X;
+                bool rest_nullable = false;
+                token_set s = first_of(g, p.rhs, i + 1, &rest_nullable);
+                if (rest_nullable) s |= g.follow[p.lhs];
+                if ((g.follow[X] | s) != g.follow[X]) {
+                    g.follow[X] |= s;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return g;
+}
+
+constexpr GrammarSets grammar_sets = compute_sets();
+
+/* Returns the FIRST and FOLLOW sets of the given nonterminal */
+constexpr token_set FIRST(nonterminal X) { return grammar_sets.first[X]; }
+constexpr token_set FOLLOW(nonterminal X) { return grammar_sets.follow[X]; }
+
+/* predict[X][t] is the index in grammar[] of the production to expand X by
+   on lookahead t, or -1 if there is none */
+struct PredictTable {
+    signed char entry[nt_null][t_null];
+    bool ll1; // false if two productions compete for an entry
+};
+
+constexpr PredictTable compute_predict() {
+    PredictTable table {};
+    table.ll1 = true;
+    for (int X = 0; X < nt_null; X++) {
+        for (int t = 0; t < t_null; t++) {
+            table.entry[X][t] = -1;
+        }
+    }
+    for (int p = 0; p < N_PRODUCTIONS; p++) {
+        nonterminal X = grammar[p].lhs;
+        bool nullable = false;
+        token_set s = first_of(grammar_sets, grammar[p].rhs, 0, &nullable);
+        if (nullable) s |= FOLLOW(X);
+        for (int t = 0; t < t_null; t++) {
+            if (!contains(s, token(t))) continue;
+            if (table.entry[X][t] != -1) table.ll1 = false;
+            table.entry[X][t] = p;
+        }
+    }
+    return table;
+}
+
+constexpr PredictTable predict_table = compute_predict();
+static_assert(predict_table.ll1, "grammar is not LL(1)");
+
+static_assert(contains(FIRST(P), t_if) && contains(FIRST(P), t_while), "FIRST(program)");
+static_assert(contains(FOLLOW(S), t_end) && contains(FOLLOW(S), t_eof), "FOLLOW(stmt)");
+
+#endif
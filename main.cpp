@@ -0,0 +1,92 @@
+/* Command-line driver: parses a calculator program from stdin or a file and
+    prints its AST, or its syntax errors and the repaired input. With
+    --batch, parses every file in a directory on several threads; with -j
+    alone, splits one program into chunks parsed on several threads. With
+    --stats, a JSON summary of every parse's counters and phase times is
+    written to stderr at the end. With --run, the program in a file is run
+    instead, and its read statements take integers from stdin; --native
+    runs it as compiled C++.
+*/
+#include <iostream>
+#include <thread>
+#include "batch.h"
+
+int main (int argc, char* argv[]) {
+    ParseOptions options;
+    const char* mapped = nullptr; // file to scan in place of stdin
+    const char* batch = nullptr;  // directory of files to parse
+    int jobs = 0;                 // threads; 0 if not given
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--flat") {
+            options.flat = true;
+        } else if (arg == "--engine=table") {
+            options.table = true;
+        } else if (arg == "--engine=rd") {
+            options.table = false;
+        } else if (arg == "--repair=cost") {
+            options.repair = true;
+        } else if (arg == "--repair=greedy") {
+            options.repair = false;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--opt" || arg == "--opt=share") {
+            options.optimize = true;
+            options.share = arg == "--opt=share";
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--pipeline") {
+            options.pipeline = true;
+        } else if (arg == "--emit=bin" && i + 1 < argc) {
+            options.binary = argv[++i];
+        } else if ((arg == "--diag=jsonl" || arg == "--diag=bin") && i + 1 < argc) {
+            options.diag_format = arg == "--diag=bin" ? f_binary : f_jsonl;
+            options.diagnostics = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cache = argv[++i];
+        } else if (arg == "--mmap" && i + 1 < argc) {
+            mapped = argv[++i];
+        } else if (arg == "--run" && i + 1 < argc) {
+            options.run = true;
+            mapped = argv[++i];
+        } else if (arg == "--native") {
+            options.native = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else {
+            cout << "Usage: parse [--engine=rd|table] [--repair=greedy|cost] [--flat] [--opt[=share]] [--stream] [--pipeline] [--stats] [--emit=bin out.ast] [--cache dir] [--diag=jsonl|bin file] [--mmap file | --run file [--native] | --batch dir] [-j threads]\n";
+            return 1;
+        }
+    }
+
+    if (options.optimize && options.stream) {
+        cout << "--stream prints statements as they are parsed and cannot be used with --opt.\n";
+        return 1;
+    }
+    if (options.run && (options.stream || options.binary != nullptr || batch != nullptr)) {
+        cout << "--run writes what the program writes and cannot be used with --stream, --emit=bin or --batch.\n";
+        return 1;
+    }
+    if (options.native && !options.run) {
+        cout << "--native only applies to --run.\n";
+        return 1;
+    }
+    if (batch != nullptr && (options.binary != nullptr || options.diagnostics != nullptr)) {
+        cout << "--emit=bin and --diag write one file and cannot be used with --batch.\n";
+        return 1;
+    }
+    int status;
+    if (batch != nullptr) {
+        status = run_batch(batch, jobs > 0 ? jobs : thread::hardware_concurrency(), options);
+    } else {
+        options.split = jobs;
+        status = parse_file(mapped, cout, options) ? 0 : 1;
+    }
+    if (options.stats) {
+        cout.flush();
+        collected_stats().print(cerr);
+    }
+    return status;
+}
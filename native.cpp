@@ -0,0 +1,326 @@
+/* C++ emitter and loader for native programs; see native.h.
+    The emitter follows the bytecode compiler (vm.cpp): left spines of
+    expressions are walked in a loop, and it recurses only into right
+    operands and nested statements. The generated function returns 0 when
+    the program ends, or an error code with the offset of the token
+    responsible. A division checks its divisor inside a GNU statement
+    expression, so it can return from the middle of an expression with its
+    operands evaluated in order.
+*/
+#include <charconv>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <fstream>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "cache.h"
+#include "native.h"
+
+extern char** environ;
+
+/* The generated function's view of its input and output. The declaration
+   is compiled here and written into every source, so the two agree. */
+#define IO_DECLARATION struct NativeIO { \
+        void* state; \
+        bool (*read)(void* state, int64_t* value); \
+        void (*write)(void* state, int64_t value); \
+    };
+IO_DECLARATION
+#define SPELL(...) SPELL_TEXT(__VA_ARGS__)
+#define SPELL_TEXT(...) #__VA_ARGS__
+
+/* What the generated function returns */
+enum native_status {ns_done, ns_division, ns_read};
+
+static const char prologue[] =
+    "// Generated by parse --run --native\n"
+    "#include <cstdint>\n\n"
+    SPELL(IO_DECLARATION) "\n\n"
+    "static inline int64_t add(int64_t a, int64_t b) { return int64_t(uint64_t(a) + uint64_t(b)); }\n"
+    "static inline int64_t sub(int64_t a, int64_t b) { return int64_t(uint64_t(a) - uint64_t(b)); }\n"
+    "static inline int64_t mul(int64_t a, int64_t b) { return int64_t(uint64_t(a) * uint64_t(b)); }\n\n"
+    "extern \"C\" int calc_run(NativeIO* io, uint32_t* at) {\n";
+
+namespace {
+
+class SourceWriter {
+    public:
+        SourceWriter(const Arena& arena, RunError& error)
+            : arena(arena), error(error), local_of(arena.symbolCount(), NO_LOCAL) { }
+        bool run(const AST_Node* root, string& source);
+    private:
+        static const uint32_t NO_LOCAL = UINT32_MAX;
+        const Arena& arena;
+        RunError& error;
+        vector <uint32_t> local_of; // the local of each variable, by symbol
+        vector <uint32_t> locals;   // the symbol of each local
+        uint32_t at = NO_OFFSET;    // offset of the statement being written
+        string body;
+
+        bool statement(const AST_Node* n, int depth);
+        bool expr(const AST_Node* n);
+        bool operand(const AST_Node* n);
+        void local(uint32_t symbol);
+        bool fail(const char* message, const AST_Node* n);
+};
+
+}
+
+bool SourceWriter::fail(const char* message, const AST_Node* n) {
+    if (error.message.empty()) {
+        error.message = message;
+        error.offset = n->offset != NO_OFFSET ? n->offset : at;
+    }
+    return false;
+}
+
+void SourceWriter::local(uint32_t symbol) {
+    if (local_of[symbol] == NO_LOCAL) {
+        local_of[symbol] = locals.size();
+        locals.push_back(symbol);
+    }
+    body.append("v").append(to_string(local_of[symbol]));
+}
+
+bool SourceWriter::operand(const AST_Node* n) {
+    if (n->label == s_error) return fail("the parser left an error node here", n);
+    int64_t value = 0;
+    switch (read_leaf(n, arena, value)) {
+        case leaf_variable:
+            local(n->label);
+            return true;
+        case leaf_literal:
+            /* A negative one through uint64_t, since INT64_MIN has no literal */
+            if (value >= 0) body.append(to_string(value));
+            else body.append("int64_t(").append(to_string(uint64_t(value))).append("ull)");
+            return true;
+        case leaf_too_big:
+            return fail("literal does not fit in 64 bits", n);
+        default:
+            return fail("cannot run this node", n);
+    }
+}
+
+/* True if an operation with right operand r must evaluate its operands
+   into locals, so that the left one is evaluated first: C++ leaves the
+   order of a call's arguments or of an operator's operands open, and
+   either may stop on a division by zero */
+static bool sequenced(const AST_Node* r) {
+    return !skip_wrappers(r)->children.empty();
+}
+
+bool SourceWriter::expr(const AST_Node* n) {
+    /* The helpers for + - *, in token order */
+    static const char* helpers[] = {"add", "sub", "mul"};
+    vector <const AST_Node*> spine;
+    for (n = skip_wrappers(n); n->kind == n_plain && n->children.size() == 2
+                               && n->label >= t_add && n->label <= t_div; n = skip_wrappers(n->children[0])) {
+        spine.push_back(n);
+    }
+    /* Each operation opens before its left operand, which is the
+       operation below it on the spine */
+    for (const AST_Node* op : spine) {
+        if (op->label == t_div || sequenced(op->children[1])) body.append("({ int64_t l = ");
+        else body.append(helpers[op->label - t_add]).append("(");
+    }
+    if (!operand(n)) return false;
+    for (size_t i = spine.size(); i-- > 0; ) {
+        const AST_Node* op = spine[i];
+        bool locals = op->label == t_div || sequenced(op->children[1]);
+        body.append(locals ? ", r = " : ", ");
+        if (!expr(op->children[1])) return false;
+        if (!locals) {
+            body.append(")");
+        } else if (op->label != t_div) {
+            body.append("; ").append(helpers[op->label - t_add]).append("(l, r); })");
+        } else {
+            /* INT64_MIN / -1 wraps like the other operations */
+            body.append("; if (r == 0) { *at = ").append(to_string(op->offset))
+                .append("; return ").append(to_string(ns_division))
+                .append("; } r == -1 ? sub(0, l) : l / r; })");
+        }
+    }
+    return true;
+}
+
+bool SourceWriter::statement(const AST_Node* n, int depth) {
+    if (n->kind == n_list || n->label == s_program) {
+        for (const AST_Node* s : n->children) {
+            if (!statement(s, depth)) return false;
+        }
+        return true;
+    }
+    at = n->offset;
+    size_t arity = n->label == t_read || n->label == t_write ? 1 : 2;
+    uint32_t label = n->children.size() == arity ? n->label : uint32_t(s_error);
+    body.append(4 * depth, ' ');
+    switch (label) {
+        case t_gets: {
+            const AST_Node* var = n->children[0];
+            int64_t unused;
+            if (read_leaf(var, arena, unused) != leaf_variable) return fail("cannot run this node", var);
+            local(var->label);
+            body.append(" = ");
+            if (!expr(n->children[1])) return false;
+            body.append(";\n");
+            return true;
+        }
+        case t_read: {
+            const AST_Node* var = skip_wrappers(n->children[0]);
+            int64_t unused;
+            if (read_leaf(var, arena, unused) != leaf_variable) return fail("cannot run this node", var);
+            body.append("if (!io->read(io->state, &");
+            local(var->label);
+            body.append(")) { *at = ").append(to_string(n->offset))
+                .append("; return ").append(to_string(ns_read)).append("; }\n");
+            return true;
+        }
+        case t_write:
+            body.append("io->write(io->state, ");
+            if (!expr(n->children[0])) return false;
+            body.append(");\n");
+            return true;
+        case t_if:
+        case t_while: {
+            /* The spellings of = through >=, in token order */
+            static const char* relations[] = {" == ", " != ", " < ", " > ", " <= ", " >= "};
+            const AST_Node* c = n->children[0];
+            if (c->kind != n_plain || c->children.size() != 2 || c->label < t_eq || c->label > t_geq) {
+                return fail("cannot run this condition", c);
+            }
+            bool locals = sequenced(c->children[1]);
+            body.append(label == t_if ? "if (" : "while (").append(locals ? "({ int64_t l = " : "");
+            if (!expr(c->children[0])) return false;
+            body.append(locals ? ", r = " : relations[c->label - t_eq]);
+            if (!expr(c->children[1])) return false;
+            if (locals) body.append("; l").append(relations[c->label - t_eq]).append("r; })");
+            body.append(") {\n");
+            if (!statement(n->children[1], depth + 1)) return false;
+            body.append(4 * depth, ' ').append("}\n");
+            return true;
+        }
+        default:
+            return fail("cannot run this statement", n);
+    }
+}
+
+bool SourceWriter::run(const AST_Node* root, string& source) {
+    if (!statement(root, 1)) return false;
+    source = prologue;
+    for (size_t i = 0; i < locals.size(); i++) {
+        string_view name = arena.label(locals[i]);
+        source.append("    int64_t v").append(to_string(i)).append(" = 0; // ")
+              .append(name.substr(1, name.size() - 2)).append("\n");
+    }
+    source.append(body).append("    return 0;\n}\n");
+    return true;
+}
+
+bool emit_native(const AST_Node* root, const Arena& arena, string& source, RunError& error) {
+    error = RunError();
+    return SourceWriter(arena, error).run(root, source);
+}
+
+string native_cache_dir() {
+    const char* tmp = getenv("TMPDIR");
+    return string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/parse-native-" + to_string(getuid());
+}
+
+/* Runs g++ on from, writing the object to to and its messages to log.
+   Returns false, with why set, if it cannot be started or fails. */
+static bool build(const string& from, const string& to, const string& log, string& why) {
+    vector <const char*> args = {NATIVE_CXX, "-o", to.c_str(), from.c_str(), nullptr};
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    pid_t child;
+    int failed = posix_spawnp(&child, args[0], &actions, nullptr, (char* const*) args.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (failed != 0) {
+        why = string("cannot start ") + args[0] + ": " + strerror(failed);
+        return false;
+    }
+    int status = 0;
+    if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        why = string(args[0]) + " could not compile the program; see " + log;
+        return false;
+    }
+    return true;
+}
+
+NativeProgram::~NativeProgram() {
+    if (handle != nullptr) dlclose(handle);
+}
+
+bool NativeProgram::load(const string& source, const string& dir, RunError& error) {
+    /* Whoever can write to dir can choose the code that runs */
+    mkdir(dir.c_str(), 0700);
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 022) != 0) {
+        error.message = "cannot use " + dir + " for compiled programs; it must be a directory only its owner can write to";
+        return false;
+    }
+    string compiler;
+    for (const char* arg : {NATIVE_CXX}) {
+        compiler.append(arg).append(" ");
+    }
+    string path = dir + "/" + cache_key(compiler + source, ".so");
+    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    compiled = handle == nullptr;
+    if (compiled) {
+        /* The source is kept beside its object, to be read */
+        string base = path.substr(0, path.size() - 3);
+        string temp = path + ".tmp" + to_string(getpid());
+        string log = base + ".log";
+        ofstream(temp + ".cpp", ios::binary) << source;
+        bool built = build(temp + ".cpp", temp, log, error.message);
+        rename((temp + ".cpp").c_str(), (base + ".cpp").c_str());
+        if (!built) {
+            remove(temp.c_str());
+            return false;
+        }
+        remove(log.c_str());
+        rename(temp.c_str(), path.c_str());
+        handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    }
+    if (handle != nullptr) entry = (int (*)(NativeIO*, uint32_t*)) dlsym(handle, "calc_run");
+    if (entry == nullptr) {
+        error.message = string("cannot load ") + path + ": " + dlerror();
+        return false;
+    }
+    return true;
+}
+
+bool NativeProgram::run(istream& in, ostream& out, RunError& error) const {
+    struct State {
+        istream& in;
+        Emitter written;
+    } state = {in, Emitter(out, 1 << 16)};
+    NativeIO io = {
+        &state,
+        [](void* s, int64_t* value) { return bool(((State*) s)->in >> *value); },
+        [](void* s, int64_t value) {
+            char digits[24];
+            char* end = to_chars(digits, digits + sizeof(digits) - 1, value).ptr;
+            *end++ = '\n';
+            ((State*) s)->written.put(string_view(digits, end - digits));
+        }
+    };
+    uint32_t offset = NO_OFFSET;
+    switch (entry(&io, &offset)) {
+        case ns_done:
+            return true;
+        case ns_division:
+            error.message = "division by zero";
+            break;
+        default:
+            error.message = "read found no integer in the input";
+            break;
+    }
+    error.offset = offset;
+    return false;
+}
@@ -0,0 +1,56 @@
+/* Native backend: runs a parsed program as machine code (parse --run
+    --native).
+    emit_native() writes the program as one C++ function: variables become
+    locals, if and while become C++ branches and loops, and expressions
+    become C++ expressions, so the system compiler allocates registers
+    and optimizes the loops. NativeProgram::load builds that source with
+    g++ into a shared object and opens it with dlopen. Objects are kept in
+    a cache directory under the hash of their source, so a program is
+    compiled once and later runs only pay for dlopen.
+
+    The generated code keeps the semantics of the bytecode (vm.h): 64-bit
+    arithmetic that wraps, variables that start at 0, and the same errors,
+    reported at the same tokens.
+*/
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "vm.h"
+
+struct NativeIO;
+
+/* How g++ is run on the generated source; part of each object's hash */
+#define NATIVE_CXX "g++", "-O2", "-shared", "-fPIC", "-w"
+
+/* Writes C++ source equivalent to the tree under root, labelled from arena,
+   which may be simplified by optimize (opt.h) as for compile(). Returns
+   false, with error set, where compile() would. */
+bool emit_native(const AST_Node* root, const Arena& arena, string& source, RunError& error);
+
+/* The directory objects are cached in when no --cache is given: one per
+   user under the temporary directory */
+string native_cache_dir();
+
+class NativeProgram {
+    public:
+        NativeProgram() = default;
+        ~NativeProgram();
+        NativeProgram(const NativeProgram&) = delete;
+        NativeProgram& operator=(const NativeProgram&) = delete;
+
+        /* Opens the object built from source in dir, building it first if
+           it is not there. Returns false, with error set, if dir cannot be
+           made or belongs to another user, or g++ or dlopen fails. */
+        bool load(const string& source, const string& dir, RunError& error);
+        /* True if load() had to run g++ */
+        bool built() const { return compiled; }
+
+        /* Runs the loaded program as Program::run does */
+        bool run(istream& in, ostream& out, RunError& error) const;
+    private:
+        void* handle = nullptr;
+        int (*entry)(NativeIO* io, uint32_t* offset) = nullptr;
+        bool compiled = false;
+};
+
+#endif
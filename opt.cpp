@@ -0,0 +1,230 @@
+/* AST simplification; see opt.h.
+    One post-order walk with an explicit stack, so deep trees cannot
+    overflow the C++ stack. A node is simplified after its children, and
+    its simplified children are already shared, so two expressions are
+    identical exactly when their labels match and their children are the
+    same nodes. Leaves are shared through a table indexed by their
+    symbol, and other nodes through an open-addressing hash table that
+    compares just that.
+*/
+#include <algorithm>
+#include <climits>
+#include "opt.h"
+
+namespace {
+
+static size_t hash_node(const AST_Node* n) {
+    size_t h = size_t(n->label) * 0x9E3779B97F4A7C15ull + n->kind;
+    for (AST_Node* c : n->children) {
+        h = (h ^ size_t(c)) * 0x100000001B3ull;
+    }
+    return h ^ (h >> 29);
+}
+
+static bool same_node(const AST_Node* a, const AST_Node* b) {
+    if (a->label != b->label || a->kind != b->kind || a->children.size() != b->children.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a->children.size(); i++) {
+        if (a->children[i] != b->children[i]) return false;
+    }
+    return true;
+}
+
+/* The shared interior nodes, in a linear-probing table kept at most half
+   full. Slots keep the hash, so probing and growing rarely touch a node. */
+class NodeTable {
+    public:
+        /* Makes room for about n nodes */
+        void reserve(size_t n) {
+            size_t size = 1024;
+            while (size < 2 * n) size *= 2;
+            if (size > slots.size()) rehash(size);
+        }
+        /* Returns the node identical to n, adding n if there is none */
+        AST_Node* insert(AST_Node* n) {
+            if (2 * (count + 1) > slots.size()) rehash(max(size_t(1024), 2 * slots.size()));
+            size_t h = hash_node(n);
+            size_t mask = slots.size() - 1;
+            for (size_t i = h & mask; ; i = (i + 1) & mask) {
+                if (slots[i].node == nullptr) {
+                    slots[i] = {h, n};
+                    count++;
+                    return n;
+                }
+                if (slots[i].hash == h && same_node(slots[i].node, n)) return slots[i].node;
+            }
+        }
+    private:
+        struct Slot {
+            size_t hash;
+            AST_Node* node;
+        };
+        vector <Slot> slots;
+        size_t count = 0;
+
+        void rehash(size_t size) {
+            vector <Slot> old(size, Slot {0, nullptr});
+            old.swap(slots);
+            size_t mask = size - 1;
+            for (const Slot& s : old) {
+                if (s.node == nullptr) continue;
+                size_t i = s.hash & mask;
+                while (slots[i].node != nullptr) i = (i + 1) & mask;
+                slots[i] = s;
+            }
+        }
+};
+
+class Optimizer {
+    public:
+        Optimizer(Arena& arena, bool share, OptStats& stats) : arena(arena), share(share), stats(stats) {
+            /* Most plain nodes are leaves, wrappers, or shared */
+            if (share) this->shared.reserve(arena.nodeCount(n_plain) / 4);
+        }
+        AST_Node* run(AST_Node* root);
+    private:
+        Arena& arena;
+        bool share;
+        OptStats& stats;
+        vector <AST_Node*> leaves; // the shared leaf of each symbol
+        NodeTable shared;
+        string spelled; // scratch buffer for a folded value's label
+
+        AST_Node* simplify(AST_Node* n);
+        AST_Node* fold(AST_Node* n);
+        bool value(AST_Node* n, int64_t& v) const;
+};
+
+}
+
+/* True if n is a literal leaf, with its value in v. Literal labels are
+   quoted digits, with a minus sign if folding made them negative. */
+bool Optimizer::value(AST_Node* n, int64_t& v) const {
+    if (!n->children.empty()) return false;
+    string_view s = arena.label(n->label);
+    if (s.size() < 3 || s.front() != '"' || s.back() != '"') return false;
+    s = s.substr(1, s.size() - 2);
+    bool negative = s[0] == '-';
+    if (negative) s.remove_prefix(1);
+    if (s.empty() || s.size() > 18) return false; /* may not fit */
+    v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    if (negative) v = -v;
+    return true;
+}
+
+/* Folds an arithmetic node whose operands are literals, or drops an
+   operation that leaves its other operand unchanged */
+AST_Node* Optimizer::fold(AST_Node* n) {
+    token op = token(n->label);
+    if (n->kind != n_plain || n->children.size() != 2
+        || (op != t_add && op != t_sub && op != t_mul && op != t_div)) {
+        return n;
+    }
+    AST_Node* l = n->children[0];
+    AST_Node* r = n->children[1];
+    int64_t a, b;
+    bool left = value(l, a), right = value(r, b);
+    if (left && right) {
+        int64_t v;
+        bool fits;
+        switch (op) {
+            case t_add: fits = !__builtin_add_overflow(a, b, &v); break;
+            case t_sub: fits = !__builtin_sub_overflow(a, b, &v); break;
+            case t_mul: fits = !__builtin_mul_overflow(a, b, &v); break;
+            default:    fits = b != 0 && !(a == INT64_MIN && b == -1);
+                        if (fits) v = a / b;
+                        break;
+        }
+        if (!fits) return n;
+        stats.folded++;
+        spelled.assign("\"").append(to_string(v)).append("\"");
+        AST_Node* leaf = arena.make<AST_Node>(arena.intern(spelled));
+        leaf->offset = n->offset;
+        return leaf;
+    }
+    if ((right && b == 0 && (op == t_add || op == t_sub)) || (right && b == 1 && (op == t_mul || op == t_div))) {
+        stats.folded++;
+        return l;
+    }
+    if ((left && a == 0 && op == t_add) || (left && a == 1 && op == t_mul)) {
+        stats.folded++;
+        return r;
+    }
+    return n;
+}
+
+/* Simplifies n, whose children are already simplified */
+AST_Node* Optimizer::simplify(AST_Node* n) {
+    if (n->kind == n_plain && (n->label == t_id || n->label == s_num) && n->children.size() == 1
+        && n->children[0]->children.empty()) {
+        stats.unwrapped++;
+        n = n->children[0];
+    }
+    n = fold(n);
+    /* Statements stay distinct, so that later passes can tell them apart */
+    if (!share || n->kind != n_plain || n->label == t_read || n->label == t_write || n->label == t_gets
+        || n->label == s_program) {
+        return n;
+    }
+    AST_Node* same;
+    if (n->children.empty()) {
+        if (n->label >= leaves.size()) leaves.resize(max(size_t(arena.symbolCount()), 2 * leaves.size()), nullptr);
+        if (leaves[n->label] == nullptr) leaves[n->label] = n;
+        same = leaves[n->label];
+    } else {
+        same = shared.insert(n);
+    }
+    if (same != n) stats.shared++;
+    return same;
+}
+
+AST_Node* Optimizer::run(AST_Node* root) {
+    struct Frame {
+        AST_Node* node;
+        size_t child; // next child to visit
+    };
+    vector <Frame> open = {{root, 0}};
+    AST_Node* done = nullptr; // the last node simplified
+    while (!open.empty()) {
+        Frame& f = open.back();
+        if (done != nullptr) {
+            f.node->children[f.child - 1] = done;
+            done = nullptr;
+        }
+        if (f.child < f.node->children.size()) {
+            stats.nodes_before++;
+            open.push_back({f.node->children[f.child++], 0});
+            continue;
+        }
+        done = simplify(f.node);
+        open.pop_back();
+    }
+    stats.nodes_before++; /* the root */
+    return done;
+}
+
+AST_Node* optimize(AST_Node* root, Arena& arena, bool share, OptStats* stats) {
+    OptStats local;
+    AST_Node* result = Optimizer(arena, share, stats != nullptr ? *stats : local).run(root);
+    if (stats == nullptr) return result;
+
+    /* Count the distinct nodes left */
+    vector <AST_Node*> seen;
+    vector <AST_Node*> pending = {result};
+    while (!pending.empty()) {
+        AST_Node* n = pending.back();
+        pending.pop_back();
+        seen.push_back(n);
+        for (AST_Node* c : n->children) {
+            pending.push_back(c);
+        }
+    }
+    sort(seen.begin(), seen.end());
+    stats->nodes_after = unique(seen.begin(), seen.end()) - seen.begin();
+    return result;
+}
@@ -0,0 +1,86 @@
+/* Reports what the simplification pass (opt.h) does to the tree of a
+    program: node counts, and the time of a walk over every node, before,
+    after simplifying, and after simplifying and sharing.
+
+    Usage: optbench file [runs]
+
+    The walk visits each node once for every place it is used, as a pass
+    that does not know about sharing would, and sums its labels. The best
+    of runs walks is reported.
+*/
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "opt.h"
+#include "parse.h"
+
+static uint64_t walk(AST_Node* root, size_t& visited) {
+    uint64_t sum = 0;
+    vector <AST_Node*> pending = {root};
+    visited = 0;
+    while (!pending.empty()) {
+        AST_Node* n = pending.back();
+        pending.pop_back();
+        visited++;
+        sum += n->label;
+        for (AST_Node* c : n->children) {
+            pending.push_back(c);
+        }
+    }
+    return sum;
+}
+
+/* Best time of runs walks, in milliseconds */
+static double time_walk(AST_Node* root, int runs, size_t& visited) {
+    double best = 1e30;
+    volatile uint64_t sink = 0;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        sink = sink + walk(root, visited);
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+/* Parses path, simplifies its tree and prints what changed. Returns false
+   if the file cannot be read or has syntax errors. */
+static bool measure(const char* path, bool share, int runs) {
+    ostringstream log;
+    Parser parser(log);
+    if (!parser.scanner.mapFile(path)) {
+        cerr << "Could not map " << path << "\n";
+        return false;
+    }
+    parser.input_token = parser.scanner.scan ();
+    AST_Node* root = parser.program();
+    if (parser.error || parser.stopped()) {
+        cerr << path << " has syntax errors\n";
+        return false;
+    }
+
+    size_t before, after;
+    double walk_before = time_walk(root, runs, before);
+    OptStats stats;
+    auto start = chrono::steady_clock::now();
+    root = optimize(root, parser.arena, share, &stats);
+    double took = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    double walk_after = time_walk(root, runs, after);
+
+    if (!share) cout << "  before:     " << before << " nodes, walk " << walk_before << " ms\n";
+    cout << (share ? "  shared:     " : "  simplified: ") << stats.nodes_after << " distinct nodes, "
+         << after << " visited by a walk, walk " << walk_after << " ms, pass " << took << " ms ("
+         << stats.unwrapped << " wrappers removed, " << stats.folded << " operators folded, "
+         << stats.shared << " nodes shared)\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: optbench file [runs]\n";
+        return 1;
+    }
+    int runs = argc > 2 ? max(1, atoi(argv[2])) : 5;
+    cout << argv[1] << ":\n";
+    return measure(argv[1], false, runs) && measure(argv[1], true, runs) ? 0 : 1;
+}
@@ -5,9 +5,8 @@
     Michael L. Scott, 2008-2020.
 */
 #include <iostream>
-#include <functional>
-#include <algorithm>
-#include "ast.h"
+#include "parse.h"
+#include "diag.h"
                        
 string names[] = {"read", "write", "id", "literal", ":=",
                        "+", "-", "*", "/", "(", ")", 
@@ -17,90 +16,173 @@ string nt_names[] = {"program", "stmt_list", "stmt", "cond",
                         "expr", "term", "factor", "term_tail", 
                         "factor_tail", "ro", "ao", "mo"};
 
-static token input_token;
-
-bool error = false; // if true, don't print the AST
-
-string input;
-
-/* If successful, returns an AST node represented by the token_image */
-AST_Node* match (token expected) {
-    if (input_token == expected) {
+/* If successful, returns an AST node represented by the scanner's token_image */
+AST_Node* Parser::match (token expected) {
+    if (input_token == expected && onInserted()) {
+        STAT(stats.tokens_inserted++);
+        AST_Node* return_node = arena.make<AST_Node>(expected);
+        return_node->offset = scanner.token_offset;
+        input.insert(expected);
+        input_token = ++inserted_at < inserted.size() ? inserted[inserted_at] : scanned;
+        return return_node;
+    } else if (input_token == expected) {
         AST_Node* return_node;
         if (input_token == t_id || input_token == t_literal)    {
-            return_node = new AST_Node("\"" + string(token_image) + "\"");
+            quoted.assign("\"").append(scanner.token_image).append("\"");
+            return_node = arena.make<AST_Node>(arena.intern(quoted));
         } else {
-            return_node = new AST_Node(token_image);
+            /* Keywords and operators are spelled as their names */
+            return_node = arena.make<AST_Node>(input_token);
         }
-        input = input + token_image + " ";
-        input_token = scan ();
+        size_t at = scanner.token_offset;
+        return_node->offset = at;
+        input_token = scanner.scan ();
+        input.keep(at, expected == t_eof ? at + 1 : scanner.token_offset);
         return return_node;
         
     } else {
         error = true;
-        cout << "Syntax error occurred during match. Expected "; 
-        if (expected == t_id || expected == t_literal) { cout << names[expected]; }
-        else { cout << "\"" << names[expected]<< "\""; }
-        cout << ". Received ";
-        if (input_token == t_id || input_token == t_literal) { cout << names[input_token] << " (\"" << token_image << "\").\n"; }
-        else { cout << "\"" << names[input_token] << "\".\n";} 
+        if (stream != nullptr) stopStream();
+        if (stopped()) return arena.make<AST_Node>(expected);
+        out << "Syntax error occurred during match. Expected "; 
+        if (expected == t_id || expected == t_literal) { out << names[expected]; }
+        else { out << "\"" << names[expected]<< "\""; }
+        out << ". Received ";
+        if (input_token == t_id || input_token == t_literal) { out << names[input_token] << " (\"" << scanner.token_image << "\").\n"; }
+        else { out << "\"" << names[input_token] << "\".\n";} 
        
-        if (input_token == t_eof) {
-            cout << "End of file reached. Transformed input.\n" << input;
-            exit(1);
+        bool fatal = input_token == t_eof && fatal_eof;
+        if (diagnostics != nullptr) {
+            Diagnostic d = {d_match, fatal ? r_stop : r_insert};
+            d.received = input_token;
+            d.inserted = expected;
+            d.expected = bit(expected);
+            d.offset = scanner.token_offset;
+            d.text = scanner.token_image;
+            diagnostics->record(d);
+        }
+        if (fatal) {
+            out << "End of file reached. Transformed input.\n";
+            input.print(out, scanner.source());
+            halted = true;
         }
-        input = input + names[expected] + " ";
-        return (new AST_Node(names[expected]));
+        STAT(stats.tokens_inserted++);
+        input.insert(expected);
+        AST_Node* inserted = arena.make<AST_Node>(expected);
+        inserted->offset = scanner.token_offset;
+        return inserted;
     }
 }
 
-/* All nonterminals return AST nodes of a syntax tree. */
-AST_Node* program ();
-SL_Node* stmt_list (SL_Node* s1);
-AST_Node* stmt ();
-AST_Node* cond ();
-AST_Node* expr ();
-AST_Node* term ();
-AST_Node* term_tail (AST_Node* t1);
-AST_Node* factor ();
-AST_Node* factor_tail (AST_Node* f1);
-AST_Node* rel_op ();
-AST_Node* add_op ();
-AST_Node* mul_op ();
-
-/* Returns a list of tokens in FIRST and FOLLOW sets of the given nonterminal */
-vector <token> FIRST(nonterminal X);
-vector <token> FOLLOW(nonterminal X);
-
 /* Method to help printing of error messages */
-string vecToString(vector <token> T);
+static string setToString(token_set T);
+
+/* Built with -DTHROW_RECOVERY, stmt_list, stmt, cond and expr first throw
+   the token of a syntax error and catch it in the same function, as they
+   did before they returned a status, so that make bench-recover can time
+   the two ways of reaching recover() against each other */
+#ifdef THROW_RECOVERY
+#define SIGNAL_ERROR() try { throw input_token; } catch (token) { }
+#else
+#define SIGNAL_ERROR()
+#endif
+
+/* Prints a token as the repair messages name it */
+static string quote(token t) {
+    return "\"" + names[t] + "\"";
+}
 
-/* Recovers from an error when inside the given subroutine of the given nonterminal */
-void recover (std::function<AST_Node* ()> subroutine, nonterminal X) {
+void Parser::repair (int deleted, const vector <token>& tokens) {
     error = true;
+    if (stream != nullptr) stopStream();
+    out << "Syntax error at " << quote(input_token) << ". Repaired by";
+    vector <token> removed;
+    for (int i = 0; i < deleted; i++) {
+        removed.push_back(i == 0 ? input_token : scanner.peek(i));
+    }
+    size_t both = min(removed.size(), tokens.size());
+    for (size_t i = 0; i < max(removed.size(), tokens.size()); i++) {
+        out << (i == 0 ? " " : ", ");
+        if (i < both) out << "replacing " << quote(removed[i]) << " with " << quote(tokens[i]);
+        else if (i < removed.size()) out << "deleting " << quote(removed[i]);
+        else out << "inserting " << quote(tokens[i]);
+    }
+    out << ".\n";
 
-    vector <token> first = FIRST(X);
-    vector <token> follow = FOLLOW(X);
-
-    cout << "Syntax error during " << nt_names[X] << ".";
-    cout << " Expected " << vecToString(first) << ". Received " << names[input_token] << ".\n";
-    
-    input_token = scan ();
-    while (input_token != t_eof) {
-        if (find(first.begin(), first.end(), input_token) != first.end()) {
-            subroutine();
-            return;
-        } else if (find(follow.begin(), follow.end(), input_token) != follow.end()) {
-            return;
-        } else {
-            input_token = scan ();
+    if (diagnostics != nullptr) {
+        Diagnostic d = {d_repair, r_skip};
+        d.offset = scanner.token_offset;
+        d.text = scanner.token_image;
+        for (token t : removed) {
+            d.repair = r_skip;
+            d.received = t;
+            d.skipped = 1;
+            diagnostics->record(d);
+            d.text = string_view(); /* later ones are not the current token */
+        }
+        for (token t : tokens) {
+            d.repair = r_insert;
+            d.received = deleted == 0 ? input_token : scanner.peek(deleted);
+            d.text = deleted == 0 ? scanner.token_image : string_view();
+            d.inserted = t;
+            d.expected = bit(t);
+            d.skipped = 0;
+            diagnostics->record(d);
         }
     }
-    cout << "End of file reached. Could not find suitable token.\n";
+
+    STAT(stats.tokens_skipped += deleted);
+    for (int i = 0; i < deleted; i++) {
+        input_token = scanner.scan ();
+    }
+    if (!tokens.empty()) {
+        inserted = tokens;
+        inserted_at = 0;
+        scanned = input_token;
+        input_token = inserted[0];
+    }
 }
 
+/* Recovers from an error inside the subroutine for nonterminal X by skipping
+   tokens. Returns true if it stopped at a token in FIRST(X), in which case
+   the caller re-runs its subroutine; false if it stopped in FOLLOW(X) or at
+   end of file. */
+bool Parser::recover (nonterminal X) {
+    error = true;
+    if (stream != nullptr) stopStream();
+    if (stopped()) return false;
+    PhaseTimer timer(stats, ph_recover);
+
+    token_set first = FIRST(X);
+    token_set follow = FOLLOW(X);
 
-AST_Node* program () {
+    out << "Syntax error during " << nt_names[X] << ".";
+    out << " Expected " << setToString(first) << ". Received " << names[input_token] << ".\n";
+
+    Diagnostic d = {d_recover, r_skip};
+    d.during = X;
+    d.expected = first;
+    d.received = input_token;
+    d.offset = scanner.token_offset;
+    d.text = scanner.token_image;
+
+    d.skipped = 1;
+    input_token = scanner.scan ();
+    while (input_token != t_eof && !contains(first, input_token) && !contains(follow, input_token)) {
+        input_token = scanner.scan ();
+        d.skipped++;
+    }
+    d.resumed = input_token != t_eof && contains(first, input_token);
+    STAT(stats.tokens_skipped += d.skipped);
+    if (input_token == t_eof && !stopped()) {
+        out << "End of file reached. Could not find suitable token.\n";
+    }
+    if (diagnostics != nullptr) diagnostics->record(d);
+    return d.resumed;
+}
+
+
+AST_Node* Parser::program () {
     switch (input_token) {
         case t_id:
         case t_read:
@@ -108,120 +190,117 @@ AST_Node* program () {
         case t_if:
         case t_while:
         case t_eof: {           /* program -> stmt_list $$ */
-            AST_Node* p_node = new AST_Node("program");
-            SL_Node* sl_node = stmt_list (new SL_Node());
+            top_list = arena.make<SL_Node>();
+            SL_Node* sl_node = stmt_list (top_list);
             AST_Node* eof_node = match (t_eof);
-            AST_Node* root = new AST_Node(p_node, sl_node);
+            AST_Node* root = arena.make<AST_Node>(s_program, sl_node);
             return root;
         }
         default: 
             //matchError ();
-            return (new AST_Node("ERROR"));
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-SL_Node* stmt_list (SL_Node* s1) {
-    try {
+/* Loops instead of recursing on stmt_list -> stmt stmt_list, so long
+   programs run in constant stack space */
+SL_Node* Parser::stmt_list (SL_Node* s1) {
+    for (;;) {
         switch (input_token) {
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_if:
-        case t_while: {         /* stmt_list -> stmt stmt_list */
-            AST_Node* s2 = stmt ();
-            s1->children.push_back(s2);
-            return stmt_list (s1);
+            case t_id:
+            case t_read:
+            case t_write:
+            case t_if:
+            case t_while: {     /* stmt_list -> stmt stmt_list */
+                AST_Node* s2 = stmt ();
+                s1->children.push_back(arena, s2);
+                if (s1 == top_list && stream != nullptr) streamStatement(s2);
+                break;
+            }
+            case t_end:
+            case t_eof:
+                return s1;      /* stmt_list -> epsilon */
+            default:            /* recover as if inside stmt, then start a new list */
+                SIGNAL_ERROR();
+                if (recover(S)) stmt ();
+                s1 = arena.make<SL_Node>();
+                break;
         }
-        case t_end:
-        case t_eof:
-            return s1;          /* stmt_list -> epsilon */
-        default: throw input_token;
-        }
-    } catch (token input_token) {
-        recover(stmt, S);
-        return stmt_list(new SL_Node());
-    }  
+    }
 }
 
-AST_Node* stmt () {
-    try {
-        switch (input_token) {
+AST_Node* Parser::stmt () {
+    switch (input_token) {
         case t_id: {            /* stmt -> id := expr */
             AST_Node* id_node = match (t_id);
             AST_Node* g_node = match (t_gets);
             AST_Node* e_node = expr ();
-            return (new AST_Node(g_node, id_node, e_node));
+            return (arena.make<AST_Node>(g_node, id_node, e_node));
         }
         case t_read: {          /* stmt -> read id */
             AST_Node* r_node = match(t_read);
             AST_Node* id_node = match(t_id);
-            return (new AST_Node(r_node, id_node));
+            return (arena.make<AST_Node>(r_node, id_node));
         }
         case t_write: {         /* stmt -> write expre */
             AST_Node* w_node = match(t_write);
             AST_Node* e_node = expr ();
-            return (new AST_Node(w_node, e_node));
+            return (arena.make<AST_Node>(w_node, e_node));
         }
         case t_if: {            /* stmt -> if cond stmt_list end */
             AST_Node* if_node = match (t_if);
             AST_Node* c_node = cond ();
-            SL_Node* sl_node = stmt_list (new SL_Node());
+            SL_Node* sl_node = stmt_list (arena.make<SL_Node>());
             AST_Node* e_node = match (t_end);
-            return (new B_Node(if_node, c_node, sl_node));
+            return (arena.make<B_Node>(if_node, c_node, sl_node));
         }
         case t_while: {         /* stmt -> while cond stmt_list end */
             AST_Node* w_node = match(t_while);
             AST_Node* c_node = cond ();
-            SL_Node* sl_node = stmt_list (new SL_Node());
+            SL_Node* sl_node = stmt_list (arena.make<SL_Node>());
             AST_Node* end_node = match (t_end);
-            return (new B_Node(w_node, c_node, sl_node));
+            return (arena.make<B_Node>(w_node, c_node, sl_node));
         }
-        default: throw input_token;
-        }
-    } catch (token input_token) {
-        recover(stmt, S);
-        return (new AST_Node("ERROR"));
+        default:
+            SIGNAL_ERROR();
+            if (recover(S)) stmt ();
+            return (arena.make<AST_Node>(s_error));
     }
-    
 }
 
-AST_Node* cond () {
-    try {
-        switch (input_token) {
+AST_Node* Parser::cond () {
+    switch (input_token) {
         case t_id:
         case t_literal:
         case t_lparen: {        /* cond -> expr ro expr */
             AST_Node* e1 = expr ();
             AST_Node* rel_node = rel_op ();
             AST_Node* e2 = expr ();
-            return (new AST_Node(rel_node, e1, e2));
-        }
-        default: throw input_token;
+            return (arena.make<AST_Node>(rel_node, e1, e2));
         }
-    } catch (token input_token) {
-        recover(cond, C);
-        return (new AST_Node("ERROR"));
+        default:
+            SIGNAL_ERROR();
+            if (recover(C)) cond ();
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* expr () {
-    try {
-        switch (input_token) {
+AST_Node* Parser::expr () {
+    switch (input_token) {
         case t_id:
         case t_literal:
         case t_lparen: {        /* expr -> term term_tail */
             AST_Node* t_node = term ();
             return term_tail(t_node);
         }
-        default: throw input_token;
-        }
-    } catch (token input_token) {
-        recover(expr, E);
-        return (new AST_Node("ERROR"));
+        default:
+            SIGNAL_ERROR();
+            if (recover(E)) expr ();
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* term () {
+AST_Node* Parser::term () {
     switch (input_token) {
         case t_id:
         case t_literal:
@@ -230,51 +309,52 @@ AST_Node* term () {
             return factor_tail(f_node);
         }
         default: //matchError ();
-        return (new AST_Node("ERROR"));
+        return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* term_tail (AST_Node* t1) {
-    switch (input_token) {
-        case t_add:
-        case t_sub: {           /* term_tail -> ado term term_tail */
-            AST_Node* add_node = add_op ();
-            AST_Node* t2 = term ();
-            AST_Node* n = new AST_Node(add_node, t1, t2);
-            return term_tail (n);
+/* Loops instead of recursing on each operator, folding to the left */
+AST_Node* Parser::term_tail (AST_Node* t1) {
+    for (;;) {
+        switch (input_token) {
+            case t_add:
+            case t_sub: {           /* term_tail -> ado term term_tail */
+                AST_Node* add_node = add_op ();
+                AST_Node* t2 = term ();
+                t1 = arena.make<AST_Node>(add_node, t1, t2);
+                break;
+            }
+            case t_eq:
+            case t_neq:
+            case t_less:
+            case t_great:
+            case t_leq:
+            case t_geq:
+            case t_rparen:
+            case t_id:
+            case t_read:
+            case t_write:
+            case t_if:
+            case t_while:
+            case t_end:
+            case t_eof:
+                return t1;          /* term_tail -> epsilon */
+            default: 
+                //matchError ();
+                return (arena.make<AST_Node>(s_error));
         }
-        case t_eq:
-        case t_neq:
-        case t_less:
-        case t_great:
-        case t_leq:
-        case t_geq:
-        case t_rparen:
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_if:
-        case t_while:
-        case t_end:
-        case t_eof:
-            return t1;          /* term_tail -> epsilon */
-        default: 
-            //matchError ();
-            return (new AST_Node("ERROR"));
     }
 }
 
-AST_Node* factor () {
+AST_Node* Parser::factor () {
     switch (input_token) {
         case t_literal: {       /* factor -> lit */
             AST_Node* t_node = match (t_literal);
-            AST_Node* lit_node = new AST_Node("num");
-            return (new AST_Node(lit_node, t_node));
+            return (arena.make<AST_Node>(s_num, t_node));
         }   
         case t_id : {           /* factor -> id */
             AST_Node* t_node = match (t_id);
-            AST_Node* id_node = new AST_Node("id");
-            return (new AST_Node(id_node, t_node));
+            return (arena.make<AST_Node>(t_id, t_node));
         }
         case t_lparen: {        /* factor -> ( expr ) */
             AST_Node* lp_node = match (t_lparen);
@@ -284,43 +364,46 @@ AST_Node* factor () {
         }   
         default: 
             //matchError ();
-            return (new AST_Node("ERROR"));
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* factor_tail (AST_Node* f1) {
-    switch (input_token) {
-        case t_mul:
-        case t_div: {           /* factor_tail -> mo factor factor_tail */
-            AST_Node* mul_node = mul_op ();
-            AST_Node* f2 = factor ();
-            AST_Node* n = new AST_Node(mul_node, f1, f2);
-            return factor_tail (n);
+/* Loops instead of recursing on each operator, folding to the left */
+AST_Node* Parser::factor_tail (AST_Node* f1) {
+    for (;;) {
+        switch (input_token) {
+            case t_mul:
+            case t_div: {           /* factor_tail -> mo factor factor_tail */
+                AST_Node* mul_node = mul_op ();
+                AST_Node* f2 = factor ();
+                f1 = arena.make<AST_Node>(mul_node, f1, f2);
+                break;
+            }
+            case t_add:
+            case t_sub:
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_less:
+            case t_great:
+            case t_leq:
+            case t_geq:
+            case t_id:
+            case t_read:
+            case t_write:
+            case t_if:
+            case t_while:
+            case t_end:
+            case t_eof:
+                return f1;          /* factor -> epsilon */
+            default: 
+                //matchError ();
+                return (arena.make<AST_Node>(s_error));
         }
-        case t_add:
-        case t_sub:
-        case t_rparen:
-        case t_eq:
-        case t_neq:
-        case t_less:
-        case t_great:
-        case t_leq:
-        case t_geq:
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_if:
-        case t_while:
-        case t_end:
-        case t_eof:
-            return f1;          /* factor -> epsilon */
-        default: 
-            //matchError ();
-            return (new AST_Node("ERROR"));
     }
 }
 
-AST_Node* rel_op () {
+AST_Node* Parser::rel_op () {
     switch (input_token) {
         case t_eq: {            /* ro -> = */
             AST_Node* eq_node = match (t_eq);
@@ -348,11 +431,11 @@ AST_Node* rel_op () {
         }
         default: 
             //matchError ();
-            return (new AST_Node("ERROR"));
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* add_op () {
+AST_Node* Parser::add_op () {
     switch (input_token) {
         case t_add: {           /* ao -> + */
             AST_Node* add_node = match (t_add);
@@ -364,11 +447,11 @@ AST_Node* add_op () {
         }
         default: 
            // matchError ();
-            return (new AST_Node("ERROR"));
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-AST_Node* mul_op () {
+AST_Node* Parser::mul_op () {
     switch (input_token) {
         case t_mul: {           /* mo -> * */
             AST_Node* mul_node = match (t_mul);
@@ -380,96 +463,69 @@ AST_Node* mul_op () {
         }
         default: 
             //matchError ();
-            return (new AST_Node("ERROR"));
+            return (arena.make<AST_Node>(s_error));
     }
 }
 
-/* Returns a list of tokens in the FIRST set of the given nonterminal */
-vector <token> FIRST(nonterminal X) {
-    switch (X) {
-        case P:
-            return {t_id, t_read, t_write, t_eof};
-            break;
-        case SL:
-        case S:
-            return {t_id, t_read, t_write, t_if, t_while};
-            break;
-        case C:
-        case E:
-        case T:
-        case F:
-            return {t_lparen, t_id, t_literal};
-            break;
-        case TT:
-        case ao:
-            return {t_add, t_sub};
-            break;
-        case FT: 
-        case mo:
-            return {t_mul, t_div};
-            break;
-        case ro:
-            return {t_eq, t_neq, t_less, t_great, t_leq, t_geq};
-            break;
-        default: return {t_null};
+/* Prints a finished top-level statement as the tree printer would */
+void Parser::streamStatement (AST_Node* s) {
+    if (streamed == 0) {
+        stream->put("(program \n  [ ");
+    } else {
+        stream->put('\n');
+        stream->indent(4);
     }
+    s->printAST_Node(2, arena, *stream);
+    streamed++;
 }
 
-/* Returns a list of tokens in the FOLLOW set of the given nonterminal */
-vector <token> FOLLOW(nonterminal X) {
-    switch (X) {
-        case P:
-            return {t_null};
-            break;
-        case SL:
-            return {t_eof};
-            break;
-        case S:
-            return {t_id, t_read, t_write, t_if, t_while, t_eof};
-            break;
-        case C:
-            return {t_id, t_read, t_write, t_if, t_while, t_end};
-        case E:
-        case TT:
-            return {t_rparen, t_id, t_read, t_write, t_if, t_while, t_eof};
-            break;
-        case T:
-        case FT:
-            return {t_add, t_sub, t_rparen, t_id, t_read, t_write, t_if, t_while, t_eof};
-            break;
-        case F: 
-            return {t_add, t_sub, t_mul, t_div, t_rparen, t_id, t_read, t_write, t_if, t_while, t_eof};
-            break;
-        case ro:
-        case ao:
-        case mo:
-            return {t_lparen, t_id, t_literal};
-            break;
-        default: return {t_null};
-    }
+void Parser::finishStream () {
+    if (streamed == 0) stream->put("(program \n  [ ");
+    stream->put('\n');
+    stream->indent(2);
+    stream->put("]\n)");
+    stream->flush();
 }
 
-/* Converts a vector to a string for pretty printing */
-string vecToString(vector <token> T) {
-    string s = names[T.at(0)];
-    int n = T.size();
-    if (n > 2) {
-        for (int i = 1; i < n - 1; i++) {
-            s = s.append(", " + names[T.at(i)]);
+/* Ends the partial tree and flushes it, so the diagnostics follow it */
+void Parser::stopStream () {
+    if (streamed > 0) stream->put('\n');
+    stream->flush();
+    stream = nullptr;
+}
+
+bool has_error_node (const AST_Node* n) {
+    vector <const AST_Node*> pending = {n};
+    while (!pending.empty()) {
+        n = pending.back();
+        pending.pop_back();
+        if (n->label == s_error) return true;
+        for (const AST_Node* c : n->children) {
+            pending.push_back(c);
         }
     }
-    s = s.append(" or " + names[T.at(n - 1)]);
-    return s;
+    return false;
 }
 
-int main () {
-    input_token = scan ();
-    AST_Node* p = program();
-    if (!error) {
-        p->printAST_Node(0);
-    } else {
-        cout << input;
+bool ends_in_operator (string_view text) {
+    size_t last = text.find_last_not_of(" \t\n\r\f\v");
+    return last != string_view::npos && string_view("+-*/:=<>").find(text[last]) != string_view::npos;
+}
+
+/* Converts a token set to a string for pretty printing */
+static string setToString(token_set T) {
+    vector <token> members;
+    for (int t = 0; t < t_null; t++) {
+        if (contains(T, token(t))) members.push_back(token(t));
+    }
+    if (members.empty()) return "";
+    string s = names[members.at(0)];
+    int n = members.size();
+    for (int i = 1; i < n - 1; i++) {
+        s.append(", " + names[members.at(i)]);
     }
-    cout << "\n\n";
-    return 0;
+    if (n > 1) {
+        s.append(" or " + names[members.at(n - 1)]);
+    }
+    return s;
 }
@@ -0,0 +1,127 @@
+/* Parser state and helpers shared by the recursive-descent parser in
+   parse.cpp and the table-driven engine in table.cpp.
+*/
+#ifndef PARSE_H
+#define PARSE_H
+
+#include "grammar.h"
+#include "transcript.h"
+
+extern string names[];
+extern string nt_names[];
+
+/* Version of what a parse prints. Bump it whenever the grammar, the
+   diagnostics or the output format change, so results cached by older
+   parsers (cache.h) are no longer served. */
+const uint32_t PARSER_VERSION = 1;
+
+class DiagnosticWriter;
+
+/* The state of one parse: its scanner, lookahead, error state, transcript
+   and the arena that owns its nodes. Parsers share nothing, so separate
+   Parsers can run at once on different threads. */
+class Parser {
+    public:
+        /* Diagnostics, and scan errors, are written to out */
+        Parser(ostream& out = cout) : scanner(out), out(out) { scanner.stats = &stats; }
+
+        Scanner scanner;
+        token input_token;  // lookahead
+        bool error = false; // if true, don't print the AST
+        Transcript input;   // transformed input, printed after errors
+        Arena arena;        // owns every node of the parse
+        ostream& out;
+        /* Counters and phase times of this parse (stats.h). Node counts
+           are kept by the arena until run_parse copies them here. */
+        ParseStats stats;
+
+        /* If true, a token missing at end of file ends the parse: the
+           transformed input is printed and halted is set. Otherwise the
+           token is inserted and parsing carries on. */
+        bool fatal_eof = true;
+        bool halted = false;
+
+        /* True once a fatal error ended the parse. Nothing more is printed,
+           and the tree must not be used. */
+        bool stopped() const { return halted || scanner.halted; }
+
+        /* Matches the expected token, inserting it if it is missing */
+        AST_Node* match (token expected);
+
+        /* Skips tokens after a syntax error in nonterminal X; returns true if
+           the caller should parse X again */
+        bool recover (nonterminal X);
+
+        /* Recursive-descent parse of a whole program, and of one statement.
+           input_token must hold the first token. */
+        AST_Node* program ();
+        AST_Node* stmt ();
+
+        /* Table-driven LL(1) parse of a whole program */
+        AST_Node* table_program ();
+
+        /* If set, each top-level statement is printed to stream as soon as
+           it is parsed, for as long as there is no syntax error. The first
+           error ends the partial tree with a newline and the diagnostics
+           follow it. */
+        Emitter* stream = nullptr;
+        void streamStatement (AST_Node* s);
+        /* Closes the streamed tree after a parse without errors. The output
+           is then the same as printing the whole tree. */
+        void finishStream ();
+
+        /* If set, each syntax error is also recorded here (diag.h). Scan
+           errors reach it if it is the scanner's listener too. */
+        DiagnosticWriter* diagnostics = nullptr;
+
+        /* If true, the table engine repairs a syntax error with the cheapest
+           few token insertions, deletions and substitutions that let the
+           next tokens parse (table.cpp), and falls back to match() and
+           recover() when its budget runs out first */
+        bool cost_repair = false;
+        struct RepairStats {
+            size_t repairs = 0;   // errors repaired by the search
+            size_t fallbacks = 0; // errors left to greedy recovery
+            double seconds = 0;   // spent searching, in total
+            double max_seconds = 0;
+        } repair_stats;
+
+        /* Reports a repair found by the search, deletes the first deleted
+           tokens and makes inserted the next input, ahead of the token
+           after them */
+        void repair (int deleted, const vector <token>& inserted);
+        /* True while input_token is one repair() inserted */
+        bool onInserted() const { return inserted_at < inserted.size(); }
+    private:
+        string quoted; // scratch buffer for quoting id and literal labels
+        vector <token> inserted; // tokens repair() inserted
+        size_t inserted_at = 0;  // index of input_token in inserted, if onInserted()
+        token scanned = t_null;  // the scanned token behind the inserted ones
+        SL_Node* top_list = nullptr; // the program's statement list
+        size_t streamed = 0;         // statements streamed so far
+
+        void stopStream ();
+
+        SL_Node* stmt_list (SL_Node* s1);
+        AST_Node* cond ();
+        AST_Node* expr ();
+        AST_Node* term ();
+        AST_Node* term_tail (AST_Node* t1);
+        AST_Node* factor ();
+        AST_Node* factor_tail (AST_Node* f1);
+        AST_Node* rel_op ();
+        AST_Node* add_op ();
+        AST_Node* mul_op ();
+};
+
+/* True if the tree under n holds an error node. term() and factor() leave
+   one without a diagnostic when the source ends where they expect an
+   operand, so part of a source can parse without errors and still mean
+   something else inside the whole source. */
+bool has_error_node (const AST_Node* n);
+
+/* True if the last token of text is an operator, which takes its operand
+   from whatever text follows */
+bool ends_in_operator (string_view text);
+
+#endif
@@ -0,0 +1,177 @@
+/* Benchmarks scanning, parsing, and parsing and printing on given files.
+
+    Usage: parsebench [-r runs] file...
+
+    Each phase runs on every file runs times, in a child process of its own
+    so that its peak resident set size is its own. For each phase it
+    reports tokens and statements per second over all runs, heap
+    allocations per run, peak RSS, and the percentiles of the time taken
+    by one file. The tree is printed to /dev/null. A parse that ends early,
+    as one does at a stray end, is credited only with the tokens it read.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "parse.h"
+
+/* Every heap allocation, by operator new or by the arena, ends up in
+   malloc, so wrapping glibc's malloc lets each phase count them */
+static size_t allocations = 0;
+static size_t allocated = 0;
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t n, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+
+    void* malloc(size_t size) {
+        allocations++;
+        allocated += size;
+        return __libc_malloc(size);
+    }
+    void* calloc(size_t n, size_t size) {
+        allocations++;
+        allocated += n * size;
+        return __libc_calloc(n, size);
+    }
+    void* realloc(void* p, size_t size) {
+        allocations++;
+        allocated += size;
+        return __libc_realloc(p, size);
+    }
+}
+
+struct Source {
+    string name;
+    string text;
+    size_t tokens = 0;
+    size_t statements = 0;
+};
+
+enum phase {scan_only, parse_only, parse_print};
+static const char* phase_names[] = {"scan", "parse", "parse+print"};
+
+/* Counts the tokens and statements in text. Each statement has exactly
+   one of read, write, :=, if and while. */
+static void count(string_view text, size_t& tokens, size_t& statements) {
+    ofstream sink("/dev/null");
+    Scanner scanner(sink);
+    scanner.setSource(text.data(), text.size());
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        tokens++;
+        if (t == t_read || t == t_write || t == t_gets || t == t_if || t == t_while) statements++;
+    }
+}
+
+/* Runs one phase on one source. Returns the offset it got to. */
+static size_t run(phase ph, const Source& s, ostream& sink) {
+    if (ph == scan_only) {
+        Scanner scanner(sink);
+        scanner.setSource(s.text.data(), s.text.size());
+        while (scanner.scan() != t_eof) { }
+        return s.text.size();
+    }
+    Parser parser(sink);
+    parser.scanner.setSource(s.text.data(), s.text.size());
+    parser.input_token = parser.scanner.scan ();
+    AST_Node* root = parser.program();
+    if (ph == parse_print && !parser.stopped()) {
+        if (!parser.error) root->printAST_Node(0, parser.arena, sink);
+        else parser.input.print(sink, s.text);
+    }
+    return parser.scanner.token_offset;
+}
+
+static double percentile(const vector <double>& sorted, double p) {
+    return sorted[min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+static void bench(phase ph, const vector <Source>& sources, int runs) {
+    ofstream sink("/dev/null");
+    vector <double> times;
+    size_t tokens = 0, statements = 0;
+    size_t allocations_before = allocations, allocated_before = allocated;
+    for (int r = 0; r < runs; r++) {
+        for (const Source& s : sources) {
+            auto start = chrono::steady_clock::now();
+            size_t reached = run(ph, s, sink);
+            times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+            if (reached < s.text.size()) {
+                count(string_view(s.text).substr(0, reached), tokens, statements);
+            } else {
+                tokens += s.tokens;
+                statements += s.statements;
+            }
+        }
+    }
+    double total = 0;
+    for (double t : times) total += t;
+    sort(times.begin(), times.end());
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("%-12s %7.2f M tokens/s %7.2f M statements/s %9.0f allocations/run (%.1f MB) %7ld KB peak"
+           "   ms per file: p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+           phase_names[ph], tokens / total / 1e6, statements / total / 1e6,
+           double(allocations - allocations_before) / runs,
+           double(allocated - allocated_before) / runs / 1e6, usage.ru_maxrss,
+           1e3 * percentile(times, 0.5), 1e3 * percentile(times, 0.9),
+           1e3 * percentile(times, 0.99), 1e3 * times.back());
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 5;
+    vector <Source> sources;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-r" && i + 1 < argc) {
+            runs = max(1, atoi(argv[++i]));
+            continue;
+        }
+        ifstream in(argv[i], ios::binary);
+        if (!in) {
+            cerr << "Could not read " << argv[i] << "\n";
+            return 1;
+        }
+        Source s;
+        s.name = argv[i];
+        s.text.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        sources.push_back(std::move(s));
+    }
+    if (sources.empty()) {
+        cerr << "Usage: parsebench [-r runs] file...\n";
+        return 1;
+    }
+
+    size_t bytes = 0, tokens = 0, statements = 0;
+    for (Source& s : sources) {
+        count(s.text, s.tokens, s.statements);
+        bytes += s.text.size();
+        tokens += s.tokens;
+        statements += s.statements;
+    }
+    printf("%zu files, %.1f MB, %zu tokens, %zu statements, %d runs\n",
+           sources.size(), bytes / 1e6, tokens, statements, runs);
+    fflush(stdout);
+
+    for (phase ph : {scan_only, parse_only, parse_print}) {
+        pid_t child = fork();
+        if (child == 0) {
+            bench(ph, sources, runs);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            cerr << phase_names[ph] << " failed\n";
+            return 1;
+        }
+    }
+    return 0;
+}
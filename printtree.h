@@ -0,0 +1,90 @@
+/* The tree printer shared by every AST encoding */
+#ifndef PRINTTREE_H
+#define PRINTTREE_H
+
+#include <vector>
+#include "ast.h"
+
+/* Prints a tree in the S-expression format without recursion, keeping the
+   open nodes on an explicit stack. Tree gives the kind and label of a node
+   and iterates its children with an opaque cursor:
+   first(n), done(n, c), child(n, c) and next(n, c). */
+template <class Tree>
+void printTree(Emitter& out, const Tree& tree, typename Tree::Node root, int indent) {
+    typedef typename Tree::Node Node;
+    typedef typename Tree::Cursor Cursor;
+    struct Frame {
+        Node node;
+        int indent;
+        Cursor child; // next child to print
+        bool first;
+    };
+    vector <Frame> open;
+
+    /* Prints the start of node n; nodes with children stay open on the stack */
+    auto start = [&](Node n, int indent) {
+        switch (tree.kind(n)) {
+            case n_plain:
+                if (tree.done(n, tree.first(n))) {
+                    out.put(tree.label(n));
+                    return;
+                }
+                out.put('(');
+                out.put(tree.label(n));
+                out.put(' ');
+                break;
+            case n_list:
+                indent += 2;
+                out.put('\n');
+                out.indent(indent);
+                out.put("[ ");
+                break;
+            case n_branch:
+                indent += 2;
+                out.put('(');
+                out.put(tree.label(n));
+                out.put('\n');
+                break;
+        }
+        open.push_back({n, indent, tree.first(n), true});
+    };
+
+    start(root, indent);
+    while (!open.empty()) {
+        Frame& f = open.back();
+        NodeKind kind = tree.kind(f.node);
+        if (tree.done(f.node, f.child)) {
+            switch (kind) {
+                case n_plain:
+                    out.put(')');
+                    break;
+                case n_list:
+                    out.put('\n');
+                    out.indent(f.indent);
+                    out.put("]\n");
+                    break;
+                case n_branch:
+                    out.indent(f.indent);
+                    out.put(')');
+                    break;
+            }
+            open.pop_back();
+            continue;
+        }
+        Node c = tree.child(f.node, f.child);
+        int indent = f.indent;
+        if (kind == n_plain && !f.first) {
+            out.put(' ');
+        } else if (kind == n_list && !f.first) {
+            out.put('\n');
+            out.indent(indent + 2);
+        } else if (kind == n_branch) {
+            out.indent(indent + 2);
+        }
+        f.child = tree.next(f.node, f.child);
+        f.first = false;
+        start(c, indent);
+    }
+}
+
+#endif
@@ -0,0 +1,146 @@
+/* Compares greedy error recovery with the cost-based repair search
+    (--repair=cost) on programs with one damaged token each.
+
+    Usage: repairbench file [mutations] [seed]
+
+    file must hold a valid program, one statement per line. Each mutation
+    takes a random run of statements from it, and drops, duplicates or
+    replaces one of their tokens. Mutations that still parse are not
+    counted. For each mode it reports the syntax errors reported per
+    damaged token, how often the repaired input has the same tokens as
+    the undamaged program (ids and literals count as the same token,
+    since an inserted operand has no text), and the time per parse. For
+    the repair search it also reports the time per error and how many
+    errors were left to greedy recovery.
+*/
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "parse.h"
+
+static const char* any_token[] = {"read", "write", "if", "while", "end", ":=", "+", "-",
+                                  "*", "/", "(", ")", "=", "<>", "<", ">", "<=", ">=",
+                                  "a", "n", "1", "42"};
+
+/* The tokens of text, with literals counted as ids */
+static vector <token> tokens_of(string_view text) {
+    ostringstream log;
+    Scanner scanner(log);
+    scanner.setSource(text.data(), text.size());
+    vector <token> kinds;
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        kinds.push_back(t == t_literal ? t_id : t);
+    }
+    return kinds;
+}
+
+static size_t count(const string& s, const string& what) {
+    size_t n = 0;
+    for (size_t at = s.find(what); at != string::npos; at = s.find(what, at + 1)) n++;
+    return n;
+}
+
+struct Mode {
+    const char* name;
+    bool cost;
+    size_t errors = 0;
+    size_t exact = 0;
+    double seconds = 0;
+    Parser::RepairStats stats;
+};
+
+/* Parses text with the table engine and returns the repaired input */
+static string parse(Mode& mode, const string& text) {
+    ostringstream log;
+    Parser parser(log);
+    parser.fatal_eof = false;
+    parser.cost_repair = mode.cost;
+    auto start = chrono::steady_clock::now();
+    parser.scanner.setSource(text.data(), text.size());
+    parser.input_token = parser.scanner.scan ();
+    parser.table_program();
+    ostringstream repaired;
+    parser.input.print(repaired, text);
+    mode.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    mode.errors += count(log.str(), "Syntax error");
+    mode.stats.repairs += parser.repair_stats.repairs;
+    mode.stats.fallbacks += parser.repair_stats.fallbacks;
+    mode.stats.seconds += parser.repair_stats.seconds;
+    mode.stats.max_seconds = max(mode.stats.max_seconds, parser.repair_stats.max_seconds);
+    return repaired.str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: repairbench file [mutations] [seed]\n";
+        return 1;
+    }
+    ifstream in(argv[1]);
+    vector <string> lines;
+    for (string line; getline(in, line); ) lines.push_back(line);
+    int mutations = argc > 2 ? atoi(argv[2]) : 2000;
+    mt19937 rng(argc > 3 ? atoi(argv[3]) : 1);
+    if (lines.empty()) {
+        cerr << argv[1] << " is empty\n";
+        return 1;
+    }
+
+    Mode modes[] = {{"greedy", false}, {"cost", true}};
+    int damaged = 0;
+    for (int tries = 0; damaged < mutations && tries < 10 * mutations; tries++) {
+        /* A run of about 20 lines, moved to a statement boundary so it is
+           a valid program of its own */
+        size_t from = rng() % lines.size();
+        size_t to = min(lines.size(), from + 20);
+        string original;
+        for (size_t i = from; i < to; i++) original += lines[i] + "\n";
+        vector <token> expected = tokens_of(original);
+        ostringstream check;
+        Parser valid(check);
+        valid.scanner.setSource(original.data(), original.size());
+        valid.input_token = valid.scanner.scan ();
+        valid.program();
+        if (valid.error || valid.stopped() || expected.empty()) continue;
+
+        /* Damage one token */
+        istringstream words(original);
+        vector <string> text;
+        for (string w; words >> w; ) text.push_back(w);
+        size_t at = rng() % text.size();
+        switch (rng() % 3) {
+            case 0: text.erase(text.begin() + at); break;
+            case 1: text.insert(text.begin() + at, text[at]); break;
+            default: text[at] = any_token[rng() % size(any_token)]; break;
+        }
+        string damaged_text;
+        for (const string& w : text) damaged_text += w + " ";
+        ostringstream check2;
+        Parser still(check2);
+        still.scanner.setSource(damaged_text.data(), damaged_text.size());
+        still.input_token = still.scanner.scan ();
+        still.program();
+        if (!still.error) continue;
+
+        damaged++;
+        for (Mode& m : modes) {
+            if (tokens_of(parse(m, damaged_text)) == expected) m.exact++;
+        }
+    }
+
+    cout << argv[1] << ": " << damaged << " programs with one damaged token\n";
+    for (const Mode& m : modes) {
+        cout << "  " << m.name << ": " << double(m.errors) / damaged << " errors reported per damaged token, "
+             << 100.0 * m.exact / damaged << "% repaired to the original tokens, "
+             << 1e6 * m.seconds / damaged << " us per parse\n";
+        size_t searched = m.stats.repairs + m.stats.fallbacks;
+        if (m.cost && searched > 0) {
+            cout << "    search: " << 1e6 * m.stats.seconds / searched << " us per error, max "
+                 << 1e6 * m.stats.max_seconds << " us, " << m.stats.fallbacks << " of " << searched
+                 << " errors left to greedy recovery\n";
+        }
+    }
+    return 0;
+}
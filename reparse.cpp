@@ -0,0 +1,617 @@
+/* Incremental reparsing for editors; see reparse.h.
+
+    An edit is applied to the text of the slots it overlaps, and only that
+    region is rescanned and reparsed, one statement at a time. An edit
+    inside the body of an if or while is made in the body's own slots, so
+    the region is a few statements of the innermost block. If the region
+    parses without errors, its new statements replace the old ones and
+    every other statement keeps its AST.
+
+    The region takes in whatever could change how it parses in the whole
+    text: a slot before it that a token could run into or that ends in an
+    operator, which then takes its operand from the region, and the next
+    slot when the region itself stops after an operator. A region that
+    could end the block around it (an end of its own), or run into the
+    block's condition or end token, is left to the enclosing list.
+
+    A region that still has an error is kept as a damaged slot, with what
+    parse prints for its text. Its error is the whole text's too: the
+    region starts and ends between statements, so the statements around it
+    cannot take up what it leaves open, unless it leaves an if, while or end
+    unpaired. Then it may pair with text in another damaged slot, and the
+    region grows slot by slot towards the nearest one, up to MAX_GROW
+    slots. Further away, the damaged slot is taken in only when its
+    unpaired tokens and the region's pair up exactly. In a block body they
+    may also pair with the block's own if or while and end, so the region
+    is left to the enclosing list unless the whole text is unbalanced
+    anyway. At the top level an unpaired token can only pair with damaged
+    text, and the region is kept as it is when there is none. An edit that
+    removes unpaired tokens from between two damaged slots has the nearest
+    ones on either side look for a partner again.
+
+    The statements before the error keep their own slots, and so do those
+    after it from the first statement on which the rest of the region
+    parses. An edit next to a damaged slot takes it in, so fixing the error
+    reparses only that slot.
+
+    Statement lengths are kept in a Fenwick tree, so finding the statements
+    an edit touches does not depend on the size of the program, and an edit
+    that adds or removes statements reuses the slots it replaced instead of
+    shifting the others.
+
+    Replaced statements stay in the parser's arena until the whole text is
+    parsed again, which resets it. Once they outweigh the live statements,
+    an edit parses the whole text again for that reason alone, so memory
+    stays proportional to the text.
+*/
+#include <algorithm>
+#include "reparse.h"
+
+/* Garbage an arena may hold before it is reclaimed, beyond the live bytes */
+static const size_t MIN_GARBAGE = 1 << 20;
+
+/* Slots a region may take in to reach damaged text its if, while or end
+   tokens could pair with */
+static const size_t MAX_GROW = 32;
+
+static bool ends_in_space(string_view s) {
+    return !s.empty() && isspace((unsigned char) s.back());
+}
+
+/* True if the first token of text is an operator that can continue the
+   expression before it */
+static bool starts_with_operator(string_view text) {
+    for (char c : text) {
+        if (!isspace((unsigned char) c)) return c == '+' || c == '-' || c == '*' || c == '/';
+    }
+    return false;
+}
+
+/* Offset of the first token of a statement */
+static size_t statement_offset(const AST_Node* s) {
+    size_t at = s->offset;
+    if (!s->children.empty() && s->children[0]->offset < at) at = s->children[0]->offset;
+    return at;
+}
+
+/* A statement start: its offset in a text, and the count of if and while
+   tokens less end tokens before it */
+struct Cut {
+    size_t at;
+    int depth;
+};
+
+/* Counts if and while tokens less end tokens through text: depth is the
+   count at the end and low the lowest it reaches. Statement starts go to
+   cuts, if given. */
+static void pairing(string_view text, int& depth, int& low, vector <Cut>* cuts) {
+    ostream discard(nullptr);
+    Scanner scanner(discard);
+    scanner.errors_fatal = false;
+    scanner.setSource(text.data(), text.size());
+    depth = low = 0;
+    size_t id = SIZE_MAX; // an identifier that starts a statement if := follows
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        size_t at = scanner.token_offset;
+        if (cuts != nullptr) {
+            if (t == t_gets && id != SIZE_MAX) cuts->push_back({id, depth});
+            if (t == t_read || t == t_write || t == t_if || t == t_while) cuts->push_back({at, depth});
+        }
+        id = t == t_id ? at : SIZE_MAX;
+        if (t == t_if || t == t_while) depth++;
+        if (t == t_end) low = min(low, --depth);
+    }
+}
+
+void Document::Stmt::appendTo(string& out) const {
+    if (!block) {
+        out += text;
+        return;
+    }
+    out += block->head;
+    for (const Stmt& s : block->body.stmts) {
+        s.appendTo(out);
+    }
+    out += block->tail;
+}
+
+size_t Document::Stmt::length() const {
+    return block ? block->head.size() + block->body.size() + block->tail.size() : text.size();
+}
+
+string_view Document::Stmt::ending() const {
+    return block ? string_view(block->tail) : string_view(text);
+}
+
+size_t Document::Stmt::damage() const {
+    return damaged ? 1 : block ? block->body.damaged : 0;
+}
+
+size_t Document::Stmt::imbalance() const {
+    return damaged ? depth != 0 || low < 0 : block ? block->body.unbalanced : 0;
+}
+
+/* The library parser inserts missing tokens at end of file and skips
+   characters outside the language instead of stopping */
+Document::Document(string_view text) : parser(log) {
+    parser.fatal_eof = false;
+    parser.scanner.errors_fatal = false;
+    parseAll(string(text));
+}
+
+/* Resets the parser's error state and transcript and starts it on text */
+void Document::start(string_view text) {
+    log.str("");
+    parser.error = false;
+    parser.input.clear();
+    parser.scanner.setSource(text.data(), text.size());
+    parser.input_token = parser.scanner.scan ();
+}
+
+/* Parses text as a sequence of statements, one slot each, onto out.
+   Returns true if all of it parses; the last statement may still stop
+   after an operator. Otherwise out holds the statements before the first
+   one with an error, and stop is where that one starts. */
+bool Document::parseStatements(string_view text, vector <Stmt>& out, size_t& stop) {
+    vector <size_t> starts;
+    vector <AST_Node*> asts;
+    start(text);
+    bool clean = !parser.scanner.error_seen;
+    while (clean && parser.input_token != t_eof) {
+        starts.push_back(parser.scanner.token_offset);
+        if (!contains(FIRST(S), parser.input_token)) {
+            clean = false;
+            break;
+        }
+        AST_Node* s = parser.stmt ();
+        if (parser.error || parser.scanner.error_seen) {
+            clean = false;
+            break;
+        }
+        asts.push_back(s);
+    }
+    size_t n = asts.size();
+    if (!clean) {
+        /* A statement that stops after an operator took its operand from the error */
+        for (size_t k = 0; k < asts.size(); k++) {
+            if (has_error_node(asts[k])) {
+                n = k;
+                break;
+            }
+        }
+    }
+    stop = clean ? text.size() : n == 0 ? 0 : starts[n];
+    for (size_t k = 0; k < n; k++) {
+        size_t from = k == 0 ? 0 : starts[k];
+        size_t to = k + 1 < n ? starts[k + 1] : stop;
+        Stmt slot;
+        slot.text = string(text.substr(from, to - from));
+        slot.asts.push_back(asts[k]);
+        if (asts[k]->kind == n_branch) makeBlock(slot, from);
+        out.push_back(std::move(slot));
+    }
+    return clean;
+}
+
+/* Gives a slot holding one if or while statement a slot of its own for
+   each statement of its body. The offsets of the statement's nodes count
+   from base bytes before the slot's text. */
+void Document::makeBlock(Stmt& s, size_t base) {
+    const AST_Node* sl = s.asts[0]->children[1];
+    const string& t = s.text;
+    size_t tail = t.find_last_not_of(" \t\n\v\f\r") - 2; // the end token
+    size_t n = sl->children.size();
+    size_t from = n == 0 ? tail : statement_offset(sl->children[0]) - base;
+    unique_ptr <Block> block(new Block);
+    block->head = t.substr(0, from);
+    block->tail = t.substr(tail);
+    for (size_t k = 0; k < n; k++) {
+        size_t to = k + 1 < n ? statement_offset(sl->children[k + 1]) - base : tail;
+        Stmt slot;
+        slot.text = t.substr(from, to - from);
+        slot.asts.push_back(sl->children[k]);
+        if (slot.asts[0]->kind == n_branch) makeBlock(slot, base + from);
+        block->body.stmts.push_back(std::move(slot));
+        from = to;
+    }
+    if (n == 0) block->body.stmts.emplace_back();
+    block->body.buildIndex();
+    s.text = string();
+    s.block = std::move(block);
+}
+
+/* A damaged slot holding text, with what parse prints for its statements */
+Document::Stmt Document::damage(string text) {
+    Stmt s;
+    s.damaged = true;
+    pairing(text, s.depth, s.low, nullptr);
+    start(text);
+    while (parser.input_token != t_eof && !parser.stopped()) {
+        parser.stmt (); /* reports and skips a token that cannot start one */
+    }
+    parser.input.print(log, parser.scanner.source());
+    s.messages = log.str();
+    s.text = std::move(text);
+    return s;
+}
+
+/* Parses the whole text */
+void Document::parseAll(string text) {
+    tree = nullptr;
+    parser.arena.reset();
+    top = List();
+    top.stmts.emplace_back();
+    top.buildIndex();
+    count = 0;
+    change(top, nullptr, 0, 0, text);
+    live = parser.arena.bytesAllocated();
+}
+
+void Document::edit(size_t offset, size_t removed, string_view inserted) {
+    size_t n = size();
+    if (offset > n) offset = n;
+    if (removed > n - offset) removed = n - offset;
+    tree = nullptr;
+    reparsed = 0;
+    size_t unbalanced = top.unbalanced;
+    change(top, nullptr, offset, removed, inserted);
+    if (unbalanced > 0 && top.unbalanced >= 2 && top.unbalanced <= unbalanced) {
+        /* Unpaired tokens the edit separated may pair up now: the nearest
+           damaged slots on either side look for a partner again */
+        vector <size_t> starts;
+        unbalancedSlots(top, 0, starts);
+        auto next = lower_bound(starts.begin(), starts.end(), offset + inserted.size());
+        size_t total = reparsed;
+        if (next != starts.end()) {
+            change(top, nullptr, *next, 0, "");
+            total += reparsed;
+        }
+        if (next != starts.begin()) {
+            change(top, nullptr, *--next, 0, "");
+            total += reparsed;
+        }
+        reparsed = total;
+    }
+    if (parser.arena.bytesAllocated() > 2 * live + MIN_GARBAGE) {
+        parseAll(text());
+    }
+}
+
+/* Appends the offsets of the damaged slots in list whose if, while and
+   end tokens do not pair up, counting from base */
+void Document::unbalancedSlots(const List& list, size_t base, vector <size_t>& out) const {
+    for (size_t i = 0; i < list.stmts.size(); i++) {
+        const Stmt& s = list.stmts[i];
+        if (s.imbalance() == 0) continue;
+        size_t at = base + list.startOf(i);
+        if (s.block) {
+            unbalancedSlots(s.block->body, at + s.block->head.size(), out);
+        } else {
+            out.push_back(at);
+        }
+    }
+}
+
+/* Makes an edit inside list, at offsets from its start, and reparses what
+   it touches. owner is the block whose body list is, or null for the
+   top-level list. Returns false, having changed nothing, if the edit may
+   change how the text around the body parses; the caller then reparses
+   the whole block. */
+bool Document::change(List& list, const Block* owner, size_t offset, size_t removed,
+                      string_view inserted) {
+    size_t first = list.find(offset);
+    size_t last = removed > 0 ? list.find(offset + removed - 1) : first;
+
+    Stmt& s = list.stmts[first];
+    if (first == last && s.block) {
+        Block& b = *s.block;
+        size_t at = offset - list.startOf(first);
+        size_t damaged = b.body.damaged, unbalanced = b.body.unbalanced;
+        if (at >= b.head.size() && at + removed <= b.head.size() + b.body.size()
+            && change(b.body, &b, at - b.head.size(), removed, inserted)) {
+            list.addLength(first, long(inserted.size()) - long(removed));
+            list.damaged = list.damaged + b.body.damaged - damaged;
+            list.unbalanced = list.unbalanced + b.body.unbalanced - unbalanced;
+            if (placed != &b.body) return true;
+            /* The block's node takes the body's new statements */
+            SL_Node* sl = parser.arena.make<SL_Node>();
+            for (const Stmt& c : b.body.stmts) {
+                for (AST_Node* a : c.asts) {
+                    sl->children.push_back(parser.arena, a);
+                }
+            }
+            s.asts[0]->children[1] = sl;
+            return true;
+        }
+    }
+
+    /* A token at either end of the region could run into its neighbours,
+       a statement before it that ends in an operator takes its operand
+       from it, and damaged neighbours are reparsed with it */
+    while (first > 0) {
+        const Stmt& before = list.stmts[first - 1];
+        if (!before.damaged && ends_in_space(before.ending()) && !ends_in_operator(before.ending())) break;
+        first--;
+    }
+    string region;
+    for (size_t i = first; i <= last; i++) {
+        list.stmts[i].appendTo(region);
+    }
+    region.replace(offset - list.startOf(first), removed, inserted);
+    while (last + 1 < list.stmts.size() && (!ends_in_space(region) || list.stmts[last + 1].damaged)) {
+        list.stmts[++last].appendTo(region);
+    }
+
+    size_t n = list.stmts.size();
+    for (;;) {
+        bool continues = starts_with_operator(region);
+        if (continues && first > 0) {
+            string before;
+            list.stmts[--first].appendTo(before);
+            region.insert(0, before);
+            continue;
+        }
+        if (owner != nullptr) {
+            bool at_head = first == 0 && (continues || !ends_in_space(owner->head)
+                                          || ends_in_operator(owner->head));
+            bool at_tail = last + 1 == n && !ends_in_space(region);
+            if (at_head || at_tail) return false;
+        }
+
+        vector <Stmt> pieces;
+        size_t stop;
+        bool clean = parseStatements(region, pieces, stop);
+        bool open = !pieces.empty() && (has_error_node(pieces.back().asts[0]) || ends_in_operator(region));
+        if (clean && open && last + 1 < n) {
+            /* The last statement takes its operand from the next one */
+            list.stmts[++last].appendTo(region);
+            continue;
+        }
+        if (clean) {
+            reparsed = pieces.size();
+            if (pieces.empty()) {
+                pieces.emplace_back();
+                pieces[0].text = region;
+            }
+            place(list, first, last, pieces);
+            return true;
+        }
+
+        int depth, low;
+        vector <Cut> cuts;
+        pairing(region, depth, low, &cuts);
+        size_t inside = 0;
+        for (size_t i = first; i <= last; i++) {
+            inside += list.stmts[i].imbalance();
+        }
+        if (low < 0 || depth > low) {
+            /* Grow towards the nearest damaged text that the unpaired
+               tokens could pair with */
+            bool others = top.unbalanced > inside;
+            if (others && low < 0) {
+                size_t k = first;
+                while (k > 0 && first - k < MAX_GROW && list.stmts[k - 1].imbalance() == 0) k--;
+                if (k > 0 && first - k < MAX_GROW) {
+                    string before;
+                    for (size_t i = k - 1; i < first; i++) {
+                        list.stmts[i].appendTo(before);
+                    }
+                    region.insert(0, before);
+                    first = k - 1;
+                    continue;
+                }
+            }
+            if (others && depth > low) {
+                size_t k = last;
+                while (k + 1 < n && k - last < MAX_GROW && list.stmts[k + 1].imbalance() == 0) k++;
+                if (k + 1 < n && k - last < MAX_GROW) {
+                    while (last <= k) {
+                        list.stmts[++last].appendTo(region);
+                    }
+                    continue;
+                }
+            }
+            /* Unless the whole text is unbalanced too, the block's own
+               if or while and end may pair with them */
+            if (owner != nullptr && (others || depth == 0)) return false;
+            /* Further away, only damaged text whose unpaired tokens pair
+               up exactly with the region's is taken in, and only if the
+               two and everything between parse */
+            size_t other = SIZE_MAX;
+            if (others && low < 0) {
+                size_t k = first;
+                while (k > 0 && list.stmts[k - 1].imbalance() == 0) k--;
+                if (k > 0) other = k - 1;
+            } else if (others) {
+                size_t k = last;
+                while (k + 1 < n && list.stmts[k + 1].imbalance() == 0) k++;
+                if (k + 1 < n) other = k + 1;
+            }
+            if (other != SIZE_MAX) {
+                string partner;
+                list.stmts[other].appendTo(partner);
+                int d, l;
+                pairing(partner, d, l, nullptr);
+                bool pairs = other < first ? d + depth == 0 && min(l, d + low) >= 0
+                                           : depth + d == 0 && min(low, depth + l) >= 0;
+                if (pairs) {
+                    string span;
+                    for (size_t i = min(other, first); i < first; i++) {
+                        list.stmts[i].appendTo(span);
+                    }
+                    span += region;
+                    for (size_t i = last + 1; i <= max(other, last); i++) {
+                        list.stmts[i].appendTo(span);
+                    }
+                    vector <Stmt> joined;
+                    size_t bad;
+                    if (parseStatements(span, joined, bad)) {
+                        first = min(other, first);
+                        last = max(other, last);
+                        bool ends_open = !joined.empty() && (has_error_node(joined.back().asts[0])
+                                                             || ends_in_operator(span));
+                        if (ends_open && last + 1 < n) {
+                            region = std::move(span);
+                            continue;
+                        }
+                        reparsed = joined.size();
+                        place(list, first, last, joined);
+                        return true;
+                    }
+                }
+            }
+        }
+
+        /* The error is the region's own. Resume at the first statement after
+           it from which the rest of the region parses. */
+        size_t resume = region.size();
+        vector <Stmt> rest;
+        size_t from = stop;
+        for (const Cut& c : cuts) {
+            if (c.at <= from || c.depth != depth) continue;
+            string_view after = string_view(region).substr(c.at);
+            vector <Stmt> parsed;
+            size_t bad;
+            if (parseStatements(after, parsed, bad)) {
+                bool ends_open = !parsed.empty() && (has_error_node(parsed.back().asts[0])
+                                                     || ends_in_operator(after));
+                if (!ends_open || last + 1 == n) {
+                    resume = c.at;
+                    rest = std::move(parsed);
+                    break;
+                }
+            }
+            from = c.at + bad;
+        }
+        reparsed = pieces.size() + rest.size();
+        pieces.push_back(damage(region.substr(stop, resume - stop)));
+        for (Stmt& r : rest) {
+            pieces.push_back(std::move(r));
+        }
+        place(list, first, last, pieces);
+        return true;
+    }
+}
+
+/* Puts pieces in slots first to last of list. Each piece gets a slot; if
+   there are fewer slots, the last one takes the extra pieces, and slots
+   left over are emptied. Pieces that replace the whole list get a slot
+   each. */
+void Document::place(List& list, size_t first, size_t last, vector <Stmt>& pieces) {
+    placed = &list;
+    if (first == 0 && last + 1 == list.stmts.size()) {
+        list.stmts = std::move(pieces);
+        if (list.stmts.empty()) list.stmts.emplace_back();
+        list.buildIndex();
+        list.damaged = list.unbalanced = 0;
+        size_t statements = 0;
+        for (const Stmt& s : list.stmts) {
+            list.damaged += s.damage();
+            list.unbalanced += s.imbalance();
+            statements += s.asts.size();
+        }
+        if (&list == &top) count = statements;
+        return;
+    }
+
+    size_t slots = last - first + 1;
+    if (pieces.size() > slots) {
+        Stmt merged;
+        bool damaged = false;
+        for (size_t k = slots - 1; k < pieces.size(); k++) {
+            pieces[k].appendTo(merged.text);
+            merged.asts.insert(merged.asts.end(), pieces[k].asts.begin(), pieces[k].asts.end());
+            damaged = damaged || pieces[k].damaged;
+        }
+        if (damaged) merged = damage(std::move(merged.text));
+        pieces.resize(slots - 1);
+        pieces.push_back(std::move(merged));
+    }
+    for (size_t i = first; i <= last; i++) {
+        size_t k = i - first;
+        Stmt slot = k < pieces.size() ? std::move(pieces[k]) : Stmt();
+        Stmt& old = list.stmts[i];
+        list.damaged = list.damaged + slot.damage() - old.damage();
+        list.unbalanced = list.unbalanced + slot.imbalance() - old.imbalance();
+        if (&list == &top) count = count + slot.asts.size() - old.asts.size();
+        list.addLength(i, long(slot.length()) - long(old.length()));
+        old = std::move(slot);
+    }
+}
+
+string Document::text() const {
+    string t;
+    t.reserve(size());
+    for (const Stmt& s : top.stmts) {
+        s.appendTo(t);
+    }
+    return t;
+}
+
+string Document::diagnostics() const {
+    string out;
+    top.appendMessages(out);
+    return out;
+}
+
+void Document::List::appendMessages(string& out) const {
+    if (damaged == 0) return;
+    for (const Stmt& s : stmts) {
+        if (s.damaged) out += s.messages;
+        else if (s.block) s.block->body.appendMessages(out);
+    }
+}
+
+AST_Node* Document::root() {
+    if (hasErrors()) return nullptr;
+    if (tree != nullptr) return tree;
+    Arena& arena = parser.arena;
+    SL_Node* sl = arena.make<SL_Node>();
+    sl->children.reserve(arena, count);
+    for (const Stmt& s : top.stmts) {
+        for (AST_Node* a : s.asts) {
+            sl->children.push_back(arena, a);
+        }
+    }
+    tree = arena.make<AST_Node>(s_program, sl);
+    return tree;
+}
+
+/* Builds the Fenwick tree in linear time */
+void Document::List::buildIndex() {
+    fenwick.assign(stmts.size() + 1, 0);
+    for (size_t i = 1; i <= stmts.size(); i++) {
+        fenwick[i] += stmts[i - 1].length();
+        size_t parent = i + (i & -i);
+        if (parent <= stmts.size()) fenwick[parent] += fenwick[i];
+    }
+}
+
+void Document::List::addLength(size_t i, long delta) {
+    for (i++; i < fenwick.size(); i += i & -i) {
+        fenwick[i] += delta;
+    }
+}
+
+/* Offset of the first byte of slot i */
+size_t Document::List::startOf(size_t i) const {
+    size_t sum = 0;
+    for (; i > 0; i -= i & -i) {
+        sum += fenwick[i];
+    }
+    return sum;
+}
+
+/* Index of the slot containing offset; the last one at end of text */
+size_t Document::List::find(size_t offset) const {
+    size_t i = 0;
+    size_t step = 1;
+    while (step * 2 < fenwick.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (i + step < fenwick.size() && fenwick[i + step] <= offset) {
+            i += step;
+            offset -= fenwick[i];
+        }
+    }
+    return i < stmts.size() ? i : stmts.size() - 1;
+}
@@ -0,0 +1,110 @@
+/* Incremental reparsing for editors.
+    A Document keeps a program as a sequence of top-level statements, each
+    owning its own text and AST. An edit rescans and reparses only the
+    statements it touches and reuses every other statement's subtree.
+    Statements are kept in slots; an edit that adds or removes statements
+    reuses the slots of the statements it replaced, so no other slot moves.
+    An if or while statement keeps its body as slots of its own, so an edit
+    inside a block reparses statements of the innermost block around it.
+    Text with a syntax error is kept in damaged slots with its diagnostics,
+    and the slots around it keep their trees.
+*/
+#ifndef REPARSE_H
+#define REPARSE_H
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parse.h"
+
+class Document {
+    public:
+        /* Parses the whole text */
+        Document(string_view text);
+
+        /* Replaces removed bytes at offset with inserted, and reparses */
+        void edit(size_t offset, size_t removed, string_view inserted);
+
+        size_t size() const { return top.size(); } // length of the text in bytes
+        string text() const;                         // the current text
+        bool hasErrors() const { return top.damaged > 0; }
+        /* What parse prints for the text of each damaged slot, in order */
+        string diagnostics() const;
+
+        /* Top-level statements, not counting damaged text */
+        size_t statementCount() const { return count; }
+
+        /* The whole program tree, (program [ ... ]), over the current statements.
+           Null if the text has syntax errors. Built once per edit. */
+        AST_Node* root();
+        /* Owns the nodes and symbols of every tree the Document returns. An
+           edit that parses the whole text again frees them, so no tree may
+           be kept across an edit. */
+        const Arena& arena() const { return parser.arena; }
+
+        /* Statements reparsed by the last edit (for measurements) */
+        size_t lastReparsed() const { return reparsed; }
+    private:
+        struct Block;
+        /* A slot: usually one statement, from its first token to the next
+           one's. It may hold several statements, or none and only white
+           space. A damaged slot holds text that does not parse, and no tree. */
+        struct Stmt {
+            string text;               // unless block is set
+            vector <AST_Node*> asts;
+            unique_ptr <Block> block;  // if the slot is one if or while statement
+            bool damaged = false;
+            int depth = 0;             // if damaged: if and while tokens less end tokens
+            int low = 0;               // if damaged: the lowest that count reaches
+            string messages;           // if damaged: as parse prints them for text
+
+            void appendTo(string& out) const;   // appends the slot's text
+            size_t length() const;
+            string_view ending() const;         // the text the slot ends with
+            size_t damage() const;              // damaged slots in the slot
+            size_t imbalance() const;           // of those, unbalanced ones
+        };
+        /* Slots in order, with their lengths in a Fenwick tree to find a
+           slot by offset */
+        struct List {
+            vector <Stmt> stmts;       // never empty
+            vector <size_t> fenwick;
+            size_t damaged = 0;        // damaged slots here and in nested blocks
+            size_t unbalanced = 0;     // of those, ones whose ends do not pair up
+
+            void buildIndex();
+            void addLength(size_t i, long delta);
+            size_t startOf(size_t i) const;
+            size_t find(size_t offset) const;
+            size_t size() const { return startOf(stmts.size()); }
+            void appendMessages(string& out) const;
+        };
+        /* An if or while statement: its text up to the first statement of
+           its body, the body, and its end token and the white space after it */
+        struct Block {
+            string head;
+            List body;
+            string tail;
+        };
+        List top;
+        size_t count = 0;  // statements in top-level slots
+        size_t reparsed;
+        AST_Node* tree = nullptr; // root(), until the next edit
+        size_t live;              // arena bytes after the last full parse
+        const List* placed;       // the list whose slots the last edit replaced
+
+        ostringstream log;  // the parser's diagnostics
+        Parser parser;      // owns every statement's nodes
+        void start(string_view text);
+        bool parseStatements(string_view text, vector <Stmt>& out, size_t& stop);
+        void makeBlock(Stmt& s, size_t base);
+        Stmt damage(string text);
+        bool change(List& list, const Block* owner, size_t offset, size_t removed, string_view inserted);
+        void place(List& list, size_t first, size_t last, vector <Stmt>& pieces);
+        void unbalancedSlots(const List& list, size_t base, vector <size_t>& out) const;
+        void parseAll(string text);
+};
+
+#endif
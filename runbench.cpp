@@ -0,0 +1,187 @@
+/* Runs a program compiled to bytecode (vm.h) and by walking its tree, and
+    compares the times.
+
+    Usage: runbench [-r runs] [-d] program input
+
+    The tree walker is the naive interpreter the bytecode replaces: it
+    recurses over the parsed tree, dispatches on each node's label, keeps
+    variables in a hash map keyed by their symbol, and converts a
+    literal's text each time it evaluates it. Both must write the same
+    output. The best of runs is reported for each; -d also prints the
+    bytecode.
+*/
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include "parse.h"
+#include "vm.h"
+
+class TreeWalker {
+    public:
+        TreeWalker(const Arena& arena, istream& in, ostream& out) : arena(arena), in(in), out(out) { }
+        /* Returns false if the program divided by zero or ran out of input */
+        bool run(const AST_Node* root) {
+            exec(root);
+            return !failed;
+        }
+    private:
+        const Arena& arena;
+        istream& in;
+        ostream& out;
+        unordered_map <uint32_t, int64_t> variables;
+        bool failed = false;
+
+        int64_t eval(const AST_Node* n) {
+            if (n->children.empty()) {
+                string_view s = arena.label(n->label);
+                s = s.substr(1, s.size() - 2);
+                if (s[0] != '-' && (s[0] < '0' || s[0] > '9')) return variables[n->label];
+                int64_t value = 0;
+                from_chars(s.data(), s.data() + s.size(), value);
+                return value;
+            }
+            if (n->label == t_id || n->label == s_num) return eval(n->children[0]);
+            uint64_t a = eval(n->children[0]), b = eval(n->children[1]);
+            switch (n->label) {
+                case t_add: return a + b;
+                case t_sub: return a - b;
+                case t_mul: return a * b;
+                case t_div:
+                    if (b == 0) {
+                        failed = true;
+                        return 0;
+                    }
+                    return int64_t(b) == -1 ? int64_t(0 - a) : int64_t(a) / int64_t(b);
+                default:    return 0;
+            }
+        }
+
+        bool test(const AST_Node* n) {
+            int64_t a = eval(n->children[0]), b = eval(n->children[1]);
+            switch (n->label) {
+                case t_eq:    return a == b;
+                case t_neq:   return a != b;
+                case t_less:  return a < b;
+                case t_great: return a > b;
+                case t_leq:   return a <= b;
+                default:      return a >= b;
+            }
+        }
+
+        void exec(const AST_Node* n) {
+            switch (n->kind == n_list ? s_program : n->label) {
+                case s_program:
+                    for (const AST_Node* s : n->children) {
+                        if (failed) return;
+                        exec(s);
+                    }
+                    break;
+                case t_gets:
+                    variables[n->children[0]->label] = eval(n->children[1]);
+                    break;
+                case t_read:
+                    if (!(in >> variables[n->children[0]->label])) failed = true;
+                    break;
+                case t_write:
+                    out << eval(n->children[0]) << '\n';
+                    break;
+                case t_if:
+                    if (test(n->children[0])) exec(n->children[1]);
+                    break;
+                case t_while:
+                    while (!failed && test(n->children[0])) exec(n->children[1]);
+                    break;
+            }
+        }
+};
+
+/* Best time of runs calls of f, in milliseconds */
+template <class F> static double best_of(int runs, F f) {
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        best = min(best, chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 3;
+    bool disassemble = false;
+    vector <const char*> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-r" && i + 1 < argc) {
+            runs = max(1, atoi(argv[++i]));
+        } else if (arg == "-d") {
+            disassemble = true;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.size() != 2) {
+        cerr << "Usage: runbench [-r runs] [-d] program input\n";
+        return 1;
+    }
+    ifstream input_file(files[1], ios::binary);
+    if (!input_file) {
+        cerr << "Could not read " << files[1] << "\n";
+        return 1;
+    }
+    string input(istreambuf_iterator<char>(input_file), {});
+
+    ostringstream log;
+    Parser parser(log);
+    if (!parser.scanner.mapFile(files[0])) {
+        cerr << "Could not map " << files[0] << "\n";
+        return 1;
+    }
+    parser.input_token = parser.scanner.scan ();
+    AST_Node* root = parser.program();
+    if (parser.error || parser.stopped()) {
+        cerr << files[0] << " has syntax errors\n";
+        return 1;
+    }
+
+    Program program;
+    RunError error;
+    bool compiled = false;
+    double compile_ms = best_of(runs, [&] { compiled = compile(root, parser.arena, program, error); });
+    if (!compiled) {
+        cerr << "Cannot run " << files[0] << ": " << error.message << "\n";
+        return 1;
+    }
+    if (disassemble) program.print(cout);
+
+    string bytecode_out, walked_out;
+    bool bytecode_ok = true, walked_ok = true;
+    double bytecode_ms = best_of(runs, [&] {
+        istringstream in(input);
+        ostringstream out;
+        bytecode_ok = program.run(in, out, error);
+        bytecode_out = out.str();
+    });
+    double walked_ms = best_of(runs, [&] {
+        istringstream in(input);
+        ostringstream out;
+        walked_ok = TreeWalker(parser.arena, in, out).run(root);
+        walked_out = out.str();
+    });
+    if (bytecode_ok != walked_ok || bytecode_out != walked_out) {
+        cerr << "The bytecode and the tree walker disagree on " << files[0] << "\n";
+        return 1;
+    }
+
+    cout << files[0] << ": " << count(bytecode_out.begin(), bytecode_out.end(), '\n') << " lines written"
+         << (bytecode_ok ? "" : ", then stopped on an error") << "\n"
+         << "  compile:   " << program.code.size() << " instructions, " << program.frame_size
+         << " slots, " << compile_ms << " ms\n"
+         << "  bytecode:  " << bytecode_ms << " ms\n"
+         << "  tree walk: " << walked_ms << " ms, " << walked_ms / bytecode_ms << " times as long\n";
+    return 0;
+}
@@ -2,48 +2,597 @@
     Simple ad-hoc scanner for the calculator language.
     Michael L. Scott, 2008-2020.
 
+    The source is either read from stdin in large blocks into a single
+    buffer or memory-mapped from a file, and is tokenized by a table-driven
+    maximal-munch DFA, so tokens need not be separated by white space.
+    Token text is handed out as a view into the buffer rather than copied.
 */
 
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "scan.h"
 
-string token_image;
+static const size_t BLOCK_SIZE = 1 << 16;
 
-token scan() {
-    string c;
-    cin >> c; /* Gets next available string (excluding white space) */
-    token_image = c; /* Saves string int global variable */
+/* Pipelined scanning.
+    A second Scanner on a thread of its own runs ahead over the same source
+    and pushes each token, bad text included, into a single-producer,
+    single-consumer ring. The parser's Scanner pops from the ring instead of
+    running the DFA, and reports errors itself, so everything it prints
+    comes out in the same order as when scanning inline. The indices only
+    grow; a slot is index mod CAPACITY. Each side keeps a cached copy of
+    the other's index and reloads it only when the ring looks full or empty.
+*/
+struct TokenRecord {
+    token t;
+    uint32_t length;
+    size_t offset;
+};
 
-    if (cin.eof()) {
-        return t_eof;
-    } else {
-        if (isalpha(c[0])) { /* If string of alphabetic characters */
-        if (!token_image.compare("read")) { return t_read; }
-        else if (!token_image.compare("write")) { return t_write; }
-        else if (!token_image.compare("if")) { return t_if; }
-        else if (!token_image.compare("while")) { return t_while;}
-        else if (!token_image.compare("end")) { return t_end;}
-        else { return t_id; }
-        }
-        else if (isdigit(c[0])) { /* If string of digits */
-            return t_literal;
-        } else { /* All other valid input */
-            if (!token_image.compare(":=")) { return t_gets; }
-            else if (!token_image.compare("(")) { return t_lparen; }
-            else if (!token_image.compare(")")) { return t_rparen; }
-            else if (!token_image.compare("+")) { return t_add; }
-            else if (!token_image.compare("-")) { return t_sub; }
-            else if (!token_image.compare("*")) { return t_mul; }
-            else if (!token_image.compare("/")) { return t_div; }
-            else if (!token_image.compare("=")) { return t_eq; }
-            else if (!token_image.compare("<>")) { return t_neq; }
-            else if (!token_image.compare("<")) { return t_less; }
-            else if (!token_image.compare(">")) { return t_great; }
-            else if (!token_image.compare("<=")) { return t_leq; }
-            else if (!token_image.compare(">=")) { return t_geq; }
-            else {
-                cout << "Scan Error. " << c << "\n";
-                exit(1);
+struct Scanner::Pipeline {
+    static const size_t CAPACITY = 1 << 12;
+
+    TokenRecord records[CAPACITY];
+    alignas(64) atomic<size_t> tail{0}; // next slot the scanner thread fills
+    size_t cached_head = 0;             // the scanner thread's copy of head
+    alignas(64) atomic<size_t> head{0}; // next slot the parser reads
+    size_t cached_tail = 0;             // the parser's copy of tail
+    bool ended = false;                 // the parser has read t_eof
+    alignas(64) atomic<bool> cancelled{false};
+    Scanner producer;
+    thread worker;
+
+    Pipeline(const char* begin, const char* end, size_t offset) {
+        producer.setSource(begin, end - begin);
+        producer.seek(offset);
+        worker = thread([this] { produce(); });
+    }
+
+    ~Pipeline() {
+        cancelled = true;
+        worker.join();
+    }
+
+    /* Scanner thread: runs until end of file or until the parser is done */
+    void produce() {
+        for (;;) {
+            token t = producer.next();
+            size_t i = tail.load(memory_order_relaxed);
+            while (i - cached_head == CAPACITY) {
+                cached_head = head.load(memory_order_acquire);
+                if (i - cached_head < CAPACITY) break;
+                if (cancelled) return;
+                this_thread::yield();
             }
+            records[i % CAPACITY] = {t, uint32_t(producer.token_image.size()), producer.token_offset};
+            tail.store(i + 1, memory_order_release);
+            if (t == t_eof) return;
+        }
+    }
+
+    /* Waits until the record i places past head has been written */
+    const TokenRecord& wait(size_t i) {
+        size_t h = head.load(memory_order_relaxed);
+        while (h + i >= cached_tail) {
+            cached_tail = tail.load(memory_order_acquire);
+            if (h + i < cached_tail) break;
+            this_thread::yield();
+        }
+        return records[(h + i) % CAPACITY];
+    }
+
+    TokenRecord pop() {
+        TokenRecord r = wait(0);
+        head.store(head.load(memory_order_relaxed) + 1, memory_order_release);
+        return r;
+    }
+
+    /* Kind of the kth token after the current one, skipping bad text */
+    token peek(size_t k) {
+        if (ended) return t_eof;
+        for (size_t i = 0; i < CAPACITY; i++) {
+            token t = wait(i).t;
+            if (t == t_eof) return t;
+            if (t != t_null && --k == 0) return t;
+        }
+        return t_null; /* further ahead than the ring holds */
+    }
+};
+
+Scanner::Scanner(ostream& out) : out(out) {
+}
+
+Scanner::~Scanner() {
+    pipeline.reset();
+    unmap();
+}
+
+/* Reads all of stdin into the buffer, one block at a time */
+void Scanner::loadStdin() {
+    size_t n = 0;
+    for (;;) {
+        buffer.resize(n + BLOCK_SIZE);
+        ssize_t got = read(0, buffer.data() + n, BLOCK_SIZE);
+        if (got <= 0) break;
+        n += got;
+    }
+    buffer.resize(n);
+    setSource(buffer.data(), n);
+}
+
+void Scanner::setSource(const char* data, size_t length) {
+    pipeline.reset();
+    src_begin = cursor = data;
+    src_end = data + length;
+    block_start = SIZE_MAX;
+    loaded = true;
+    halted = false;
+    error_seen = false;
+}
+
+bool Scanner::mapFile(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+    size_t length = st.st_size;
+    if (length == 0) { /* mmap rejects empty mappings */
+        close(fd);
+        setSource("", 0);
+        return true;
+    }
+    void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping keeps the file open */
+    if (data == MAP_FAILED) return false;
+    madvise(data, length, MADV_SEQUENTIAL);
+    unmap();
+    mapped = data;
+    mapped_length = length;
+    setSource((const char*) data, length);
+    return true;
+}
+
+string_view Scanner::source() {
+    if (!loaded) loadStdin();
+    return string_view(src_begin, src_end - src_begin);
+}
+
+void Scanner::seek(size_t offset) {
+    if (!loaded) loadStdin();
+    cursor = src_begin + offset;
+}
+
+void Scanner::unmap() {
+    if (mapped != nullptr) munmap(mapped, mapped_length);
+    mapped = nullptr;
+}
+
+/* Character classes: the DFA's input alphabet */
+enum char_class : unsigned char {cc_other, cc_space, cc_alpha, cc_digit, cc_colon,
+                                 cc_eq, cc_less, cc_great, cc_lparen, cc_rparen,
+                                 cc_add, cc_sub, cc_mul, cc_div, n_classes};
+
+/* DFA states. s_error is the dead state. */
+enum dfa_state : unsigned char {s_start, s_id, s_literal, s_colon, s_gets,
+                                s_lparen, s_rparen, s_add, s_sub, s_mul, s_div,
+                                s_eq, s_less, s_leq, s_neq, s_great, s_geq,
+                                s_error, n_states};
+
+struct Tables {
+    unsigned char char_class[256];
+    unsigned char delta[n_states][n_classes];
+    token accept[n_states];
+    token single[256]; // the token of a character that is a whole token by itself, else t_null
+};
+
+static constexpr Tables build_tables() {
+    Tables t {};
+    for (int c = 0; c < 256; c++) {
+        t.char_class[c] = cc_other;
+    }
+    for (char c : {' ', '\t', '\n', '\r', '\f', '\v'}) t.char_class[(unsigned char) c] = cc_space;
+    for (int c = 'a'; c <= 'z'; c++) t.char_class[c] = cc_alpha;
+    for (int c = 'A'; c <= 'Z'; c++) t.char_class[c] = cc_alpha;
+    for (int c = '0'; c <= '9'; c++) t.char_class[c] = cc_digit;
+    t.char_class[':'] = cc_colon;
+    t.char_class['='] = cc_eq;
+    t.char_class['<'] = cc_less;
+    t.char_class['>'] = cc_great;
+    t.char_class['('] = cc_lparen;
+    t.char_class[')'] = cc_rparen;
+    t.char_class['+'] = cc_add;
+    t.char_class['-'] = cc_sub;
+    t.char_class['*'] = cc_mul;
+    t.char_class['/'] = cc_div;
+
+    for (int s = 0; s < n_states; s++) {
+        for (int c = 0; c < n_classes; c++) {
+            t.delta[s][c] = s_error;
+        }
+        t.accept[s] = t_null;
+    }
+    t.delta[s_start][cc_alpha] = s_id;
+    t.delta[s_start][cc_digit] = s_literal;
+    t.delta[s_start][cc_colon] = s_colon;
+    t.delta[s_start][cc_eq] = s_eq;
+    t.delta[s_start][cc_less] = s_less;
+    t.delta[s_start][cc_great] = s_great;
+    t.delta[s_start][cc_lparen] = s_lparen;
+    t.delta[s_start][cc_rparen] = s_rparen;
+    t.delta[s_start][cc_add] = s_add;
+    t.delta[s_start][cc_sub] = s_sub;
+    t.delta[s_start][cc_mul] = s_mul;
+    t.delta[s_start][cc_div] = s_div;
+    t.delta[s_id][cc_alpha] = s_id;
+    t.delta[s_id][cc_digit] = s_id;
+    t.delta[s_literal][cc_digit] = s_literal;
+    t.delta[s_colon][cc_eq] = s_gets;
+    t.delta[s_less][cc_eq] = s_leq;
+    t.delta[s_less][cc_great] = s_neq;
+    t.delta[s_great][cc_eq] = s_geq;
+
+    t.accept[s_id] = t_id;
+    t.accept[s_literal] = t_literal;
+    t.accept[s_gets] = t_gets;
+    t.accept[s_lparen] = t_lparen;
+    t.accept[s_rparen] = t_rparen;
+    t.accept[s_add] = t_add;
+    t.accept[s_sub] = t_sub;
+    t.accept[s_mul] = t_mul;
+    t.accept[s_div] = t_div;
+    t.accept[s_eq] = t_eq;
+    t.accept[s_less] = t_less;
+    t.accept[s_leq] = t_leq;
+    t.accept[s_neq] = t_neq;
+    t.accept[s_great] = t_great;
+    t.accept[s_geq] = t_geq;
+
+    /* A character whose state accepts and has no way out */
+    for (int c = 0; c < 256; c++) {
+        int state = t.delta[s_start][t.char_class[c]];
+        bool leaves = false;
+        for (int k = 0; k < n_classes; k++) {
+            if (t.delta[state][k] != s_error) leaves = true;
         }
+        t.single[c] = leaves ? t_null : t.accept[state];
     }
+    return t;
+}
+
+static constexpr Tables tables = build_tables();
+
+/* Character class bitmaps.
+    In the SIMD modes, next() does not step through white space or the
+    characters of an identifier or literal one at a time: it finds the end
+    of the run with a count of trailing zeros in a bitmap of the run's
+    class. Bitmaps cover 64 bytes, aligned to the start of the source, and
+    are built when the cursor first enters them, so the pre-pass follows
+    seek() and peek() and holds one block at a time rather than bitmaps of
+    the whole source. The same compares give a bitmap of bytes outside the
+    language, so bad text is found a block at a time: a byte marked there
+    is reported without the DFA, and the DFA only sees : < and >.
+*/
+enum ClassBits {b_space, b_word, b_digit, b_bad};
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+/* Bytes of c from lo to hi: subtracting lo moves the range to 0..hi-lo,
+   which an unsigned minimum with hi-lo leaves unchanged */
+static inline __m128i in_range(__m128i c, char lo, char hi) {
+    __m128i t = _mm_sub_epi8(c, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(hi - lo)), t);
+}
+
+/* Operator bytes: ( to / and : to >, less , . and ; */
+static inline __m128i is_operator(__m128i c) {
+    __m128i gap = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(',')),
+                                            _mm_cmpeq_epi8(c, _mm_set1_epi8('.'))),
+                               _mm_cmpeq_epi8(c, _mm_set1_epi8(';')));
+    return _mm_andnot_si128(gap, _mm_or_si128(in_range(c, '(', '/'), in_range(c, ':', '>')));
+}
+
+/* The same 16 bytes at a time; SSE2 is part of x86-64 */
+static void classify_sse2(const char* p, uint64_t bits[4]) {
+    bits[b_space] = bits[b_word] = bits[b_digit] = bits[b_bad] = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (p + 16 * i));
+        __m128i digit = in_range(c, '0', '9');
+        __m128i alpha = in_range(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i space = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), in_range(c, '\t', '\r'));
+        __m128i word = _mm_or_si128(alpha, digit);
+        __m128i good = _mm_or_si128(_mm_or_si128(space, word), is_operator(c));
+        bits[b_space] |= uint64_t(uint16_t(_mm_movemask_epi8(space))) << (16 * i);
+        bits[b_word] |= uint64_t(uint16_t(_mm_movemask_epi8(word))) << (16 * i);
+        bits[b_digit] |= uint64_t(uint16_t(_mm_movemask_epi8(digit))) << (16 * i);
+        bits[b_bad] |= uint64_t(uint16_t(~_mm_movemask_epi8(good))) << (16 * i);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i in_range(__m256i c, char lo, char hi) {
+    __m256i t = _mm256_sub_epi8(c, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(hi - lo)), t);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i is_operator(__m256i c) {
+    __m256i gap = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(',')),
+                                                  _mm256_cmpeq_epi8(c, _mm256_set1_epi8('.'))),
+                                  _mm256_cmpeq_epi8(c, _mm256_set1_epi8(';')));
+    return _mm256_andnot_si256(gap, _mm256_or_si256(in_range(c, '(', '/'), in_range(c, ':', '>')));
+}
+
+/* The same 32 bytes at a time, on CPUs that have AVX2 */
+__attribute__((target("avx2")))
+static void classify_avx2(const char* p, uint64_t bits[4]) {
+    bits[b_space] = bits[b_word] = bits[b_digit] = bits[b_bad] = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i c = _mm256_loadu_si256((const __m256i*) (p + 32 * i));
+        __m256i digit = in_range(c, '0', '9');
+        __m256i alpha = in_range(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), in_range(c, '\t', '\r'));
+        __m256i word = _mm256_or_si256(alpha, digit);
+        __m256i good = _mm256_or_si256(_mm256_or_si256(space, word), is_operator(c));
+        bits[b_space] |= uint64_t(uint32_t(_mm256_movemask_epi8(space))) << (32 * i);
+        bits[b_word] |= uint64_t(uint32_t(_mm256_movemask_epi8(word))) << (32 * i);
+        bits[b_digit] |= uint64_t(uint32_t(_mm256_movemask_epi8(digit))) << (32 * i);
+        bits[b_bad] |= uint64_t(uint32_t(~_mm256_movemask_epi8(good))) << (32 * i);
+    }
+}
+#endif
+
+bool scan_mode_supported(ScanMode mode) {
+#ifdef __x86_64__
+    return mode != scan_avx2 || __builtin_cpu_supports("avx2");
+#else
+    return mode == scan_scalar;
+#endif
+}
+
+ScanMode best_scan_mode() {
+    static const ScanMode best = scan_mode_supported(scan_avx2) ? scan_avx2
+                               : scan_mode_supported(scan_sse2) ? scan_sse2 : scan_scalar;
+    return best;
+}
+
+/* Returns the first byte from p on that is not in class bits, or src_end.
+   Most runs end in the block the cursor is in, which takes a shift and a
+   count of trailing zeros. */
+inline const char* Scanner::runEnd(const char* p, int bits) {
+    size_t at = p - src_begin;
+    if (at >= block_start && at < block_start + 64) {
+        uint64_t rest = ~block_bits[bits] >> (at - block_start);
+        if (rest != 0) return p + __builtin_ctzll(rest);
+    }
+    return runEndSlow(p, bits);
+}
+
+/* runEnd() across blocks, classifying each one it enters */
+const char* Scanner::runEndSlow(const char* p, int bits) {
+    for (;;) {
+        size_t at = p - src_begin;
+        if (at < block_start || at >= block_start + 64) classifyBlock(at);
+        uint64_t rest = ~block_bits[bits] >> (at - block_start);
+        if (rest != 0) return p + __builtin_ctzll(rest);
+        p = src_begin + block_start + 64;
+    }
+}
+
+/* Builds the bitmaps of the block holding offset at */
+void Scanner::classifyBlock(size_t at) {
+    block_start = at & ~size_t(63);
+#ifdef __x86_64__
+    const char* block = src_begin + block_start;
+    char tail[64];
+    if (src_end - block < 64) {
+        memset(tail, 0, sizeof(tail)); /* zero bytes are bad */
+        memcpy(tail, block, src_end - block);
+        block = tail;
+    }
+    if (mode == scan_avx2) classify_avx2(block, block_bits);
+    else classify_sse2(block, block_bits);
+#else
+    /* only scan_scalar is supported */
+    block_bits[b_space] = block_bits[b_word] = block_bits[b_digit] = 0;
+    block_bits[b_bad] = ~uint64_t(0);
+#endif
+}
+
+/* Perfect hash over the keywords: (length + second character) mod 16 is
+   distinct for read, write, if, while and end. */
+struct Keyword {
+    const char* text;
+    size_t length;
+    token t;
+};
+
+static constexpr size_t keyword_hash(const char* s, size_t length) {
+    return (length + (unsigned char) s[1]) & 15;
+}
+
+static constexpr Keyword keyword_list[] = {{"read", 4, t_read}, {"write", 5, t_write},
+                                          {"if", 2, t_if}, {"while", 5, t_while},
+                                          {"end", 3, t_end}};
+
+struct KeywordTable {
+    Keyword slot[16];
+    bool perfect; // false if two keywords hash to the same slot
+};
+
+static constexpr KeywordTable build_keywords() {
+    KeywordTable k {};
+    k.perfect = true;
+    for (const Keyword& kw : keyword_list) {
+        size_t h = keyword_hash(kw.text, kw.length);
+        if (k.slot[h].text != nullptr) k.perfect = false;
+        k.slot[h] = kw;
+    }
+    return k;
+}
+
+static constexpr KeywordTable keywords = build_keywords();
+static_assert(keywords.perfect, "keyword hash is not perfect");
+
+/* Returns the keyword token for an identifier, or t_id */
+static token lookup_keyword(const char* s, size_t length) {
+    if (length < 2 || length > 5) return t_id;
+    const Keyword& k = keywords.slot[keyword_hash(s, length)];
+    if (k.length == length && memcmp(k.text, s, length) == 0) return k.t;
+    return t_id;
+}
+
+/* Scans the next token from the cursor without reporting errors. Bad text
+   is returned as t_null, with token_image covering it. */
+token Scanner::next() {
+    /* Skip white space */
+    if (mode != scan_scalar) {
+        cursor = runEnd(cursor, b_space);
+    } else {
+        while (cursor < src_end && tables.char_class[(unsigned char) *cursor] == cc_space) {
+            cursor++;
+        }
+    }
+    token_offset = cursor - src_begin;
+    if (cursor == src_end) {
+        token_image = string_view(cursor, 0);
+        return t_eof;
+    }
+
+    /* An identifier or literal runs to the end of its class, which is
+       where the DFA would stop */
+    unsigned char first = tables.char_class[(unsigned char) *cursor];
+    if (mode != scan_scalar && (first == cc_alpha || first == cc_digit)) {
+        const char* start = cursor;
+        cursor = runEnd(cursor, first == cc_alpha ? b_word : b_digit);
+        token_image = string_view(start, cursor - start);
+        return first == cc_alpha ? lookup_keyword(start, cursor - start) : t_literal;
+    }
+    if (mode != scan_scalar) {
+        /* The cursor is in the current block, where a run just ended */
+        if ((block_bits[b_bad] >> (cursor - src_begin - block_start)) & 1) {
+            token_image = string_view(cursor++, 1);
+            return t_null;
+        }
+        token single = tables.single[(unsigned char) *cursor];
+        if (single != t_null) {
+            token_image = string_view(cursor++, 1);
+            return single;
+        }
+    }
+
+    /* Run the DFA, remembering the last accepting position (maximal munch) */
+    const char* start = cursor;
+    const char* p = cursor;
+    const char* last_pos = nullptr;
+    token last = t_null;
+    unsigned char state = s_start;
+    while (p < src_end) {
+        state = tables.delta[state][tables.char_class[(unsigned char) *p]];
+        if (state == s_error) break;
+        p++;
+        if (tables.accept[state] != t_null) {
+            last = tables.accept[state];
+            last_pos = p;
+        }
+    }
+
+    if (last == t_null) {
+        size_t n = p > start ? p - start : 1;
+        cursor = start + n;
+        token_image = string_view(start, n);
+        return t_null;
+    }
+    cursor = last_pos;
+    token_image = string_view(start, last_pos - start);
+    if (last == t_id) {
+        return lookup_keyword(start, last_pos - start);
+    }
+    return last;
+}
+
+token Scanner::scan() {
+#ifndef NO_PARSE_STATS
+    if (stats != nullptr) {
+        if (stats->timing && stats->tokens_scanned % SCAN_SAMPLE == SCAN_SAMPLE - 1) {
+            uint64_t start = stat_clock();
+            token t = scanToken();
+            stats->ns[ph_scan] += stat_clock() - start;
+            stats->scan_samples++;
+            stats->tokens_scanned++;
+            return t;
+        }
+        stats->tokens_scanned++;
+    }
+#endif
+    return scanToken();
+}
+
+token Scanner::scanToken() {
+    if (!loaded) loadStdin();
+    if (halted) return t_eof;
+
+    for (;;) {
+        token t = pipeline ? fromPipeline() : next();
+        if (t != t_null) return t;
+        out << "Scan Error. " << token_image << "\n";
+        if (listener != nullptr) {
+            listener->scanError(token_image.data() - src_begin, token_image, errors_fatal);
+        }
+        if (errors_fatal) {
+            halted = true;
+            cursor = src_end;
+            token_image = string_view(cursor, 0);
+            return t_eof;
+        }
+        error_seen = true; /* skip the bad text and scan on */
+    }
+}
+
+token Scanner::peek(size_t k) {
+    if (!loaded) loadStdin();
+    if (halted) return t_eof;
+    if (pipeline) return pipeline->peek(k);
+    const char* saved_cursor = cursor;
+    string_view saved_image = token_image;
+    size_t saved_offset = token_offset;
+    token t = t_eof;
+    while (k > 0) {
+        t = next();
+        if (t == t_eof) break;
+        if (t != t_null) k--;
+    }
+    cursor = saved_cursor;
+    token_image = saved_image;
+    token_offset = saved_offset;
+    return t;
+}
+
+token Scanner::fromPipeline() {
+    if (pipeline->ended) {
+        token_offset = src_end - src_begin;
+        token_image = string_view(src_end, 0);
+        return t_eof;
+    }
+    TokenRecord r = pipeline->pop();
+    if (r.t == t_eof) pipeline->ended = true;
+    token_offset = r.offset;
+    token_image = string_view(src_begin + r.offset, r.length);
+    cursor = src_begin + r.offset + r.length;
+    return r.t;
+}
+
+void Scanner::startPipeline() {
+    if (!loaded) loadStdin();
+    pipeline.reset();
+    pipeline.reset(new Pipeline(src_begin, src_end, cursor - src_begin));
 }
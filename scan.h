@@ -1,8 +1,15 @@
 /* Definitions the scanner shares with the parser
     Michael L. Scott, 2008-2020.
 */
+#ifndef SCAN_H
+#define SCAN_H
+
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "stats.h"
 
 using namespace std;
 
@@ -17,5 +24,102 @@ typedef enum {P, SL, S, C, E, T, F, TT, FT, ro, ao, mo, nt_null} nonterminal;
 /* Enumeration of the empty string */
 typedef enum {EPS, e_null} EPSILON;
 
-extern string token_image;
-extern token scan();
+/* Told of each scan error as it is reported, for structured diagnostics
+   (diag.h). offset is where the bad text starts in the source. */
+class ScanErrorListener {
+    public:
+        virtual void scanError(size_t offset, string_view text, bool fatal) = 0;
+    protected:
+        ~ScanErrorListener() { }
+};
+
+/* How the scanner finds where white space, identifiers and literals end:
+   one character at a time through the DFA, or from bitmaps of the
+   character classes of 64 bytes at a time, built with SSE2 or AVX2 */
+enum ScanMode {scan_scalar, scan_sse2, scan_avx2};
+
+/* True if this CPU can scan in mode */
+bool scan_mode_supported(ScanMode mode);
+/* The fastest mode this CPU supports */
+ScanMode best_scan_mode();
+
+/* Scanner state for one source. Each parse owns its own Scanner, so
+   several can run at once on different threads. */
+class Scanner {
+    public:
+        /* Scan errors are reported on out */
+        Scanner(ostream& out = cout);
+        ~Scanner();
+        Scanner(const Scanner&) = delete;
+        Scanner& operator=(const Scanner&) = delete;
+
+        /* Returns the next token. Reads all of stdin first if no source was set. */
+        token scan();
+
+        /* Scans the given bytes. The bytes must outlive the scan. */
+        void setSource(const char* data, size_t length);
+        /* Maps the named file into memory and scans it in place. Returns false
+           if the file cannot be opened or mapped. */
+        bool mapFile(const char* path);
+        /* The whole source, reading stdin first if no source was set */
+        string_view source();
+        /* Continues scanning at the given byte offset into the source */
+        void seek(size_t offset);
+
+        /* Starts a thread that scans the rest of the source ahead of scan()
+           into a lock-free ring, so scanning and parsing overlap. scan()
+           returns the same tokens and reports the same errors. */
+        void startPipeline();
+
+        /* Returns the kth token after the last one scanned (peek(1) is the
+           next) without consuming anything. Bad text is skipped and not
+           reported. With a pipeline, k is limited by the ring's size, and
+           t_null is returned beyond it. */
+        token peek(size_t k);
+
+        /* Text of the last token scanned. A view into the source, valid until
+           the scanner is given a new source. */
+        string_view token_image;
+        /* Byte offset of token_image from the start of the source */
+        size_t token_offset = 0;
+
+        /* If true, a character outside the language ends the scan: it is
+           reported, halted is set and every later call returns t_eof.
+           Otherwise it is reported and skipped, and error_seen is set. */
+        bool errors_fatal = true;
+        bool error_seen = false;
+        bool halted = false;
+        ScanErrorListener* listener = nullptr;
+        /* If set, scan() counts the tokens it returns here, and times a
+           sample of them if stats->timing is set */
+        ParseStats* stats = nullptr;
+        /* Must be supported (scan_mode_supported) */
+        ScanMode mode = best_scan_mode();
+    private:
+        ostream& out;
+        vector<char> buffer;            // stdin, when read
+        void* mapped = nullptr;         // mapped file, when mapped
+        size_t mapped_length = 0;
+        const char* src_begin = nullptr;
+        const char* src_end = nullptr;
+        const char* cursor = nullptr;
+        bool loaded = false;
+        struct Pipeline;
+        unique_ptr<Pipeline> pipeline;  // when scanning on another thread
+        /* Class bitmaps of the 64 bytes at offset block_start, bit i for
+           the byte at block_start + i; bytes past the end of the source
+           are bad */
+        size_t block_start = SIZE_MAX;
+        uint64_t block_bits[4];         // by ClassBits (scan.cpp)
+
+        void loadStdin();
+        void unmap();
+        token next();
+        token fromPipeline();
+        token scanToken();
+        const char* runEnd(const char* p, int bits);
+        const char* runEndSlow(const char* p, int bits);
+        void classifyBlock(size_t at);
+};
+
+#endif
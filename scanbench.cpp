@@ -0,0 +1,86 @@
+/* Measures scanning speed in each scan mode (scan.h) this CPU supports.
+
+    Usage: scanbench [-r runs] file...
+
+    Each file is read into memory and scanned to the end runs times in
+    each mode, and every mode must return the same tokens at the same
+    offsets. The best run of each mode is reported in GB/s and millions of
+    tokens per second, with its speedup over the scalar mode.
+*/
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include "scan.h"
+
+static const char* mode_names[] = {"scalar", "sse2", "avx2"};
+
+/* Scans text once; returns the token count and a hash of the tokens and
+   their offsets */
+static size_t scan_all(const string& text, ScanMode mode, uint64_t& hash) {
+    ofstream sink("/dev/null");
+    Scanner scanner(sink);
+    scanner.mode = mode;
+    scanner.errors_fatal = false;
+    scanner.setSource(text.data(), text.size());
+    size_t tokens = 0;
+    hash = 0;
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        hash = (hash ^ (scanner.token_offset << 5 | t)) * 0x100000001B3ull;
+        tokens++;
+    }
+    return tokens;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 5;
+    vector <const char*> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-r" && i + 1 < argc) {
+            runs = max(1, atoi(argv[++i]));
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty()) {
+        cerr << "Usage: scanbench [-r runs] file...\n";
+        return 1;
+    }
+
+    for (const char* path : files) {
+        ifstream in(path, ios::binary);
+        if (!in) {
+            cerr << "Could not read " << path << "\n";
+            return 1;
+        }
+        string text(istreambuf_iterator<char>(in), {});
+        printf("%s: %.1f MB\n", path, text.size() / 1e6);
+
+        double scalar = 0;
+        uint64_t expected = 0;
+        for (ScanMode mode : {scan_scalar, scan_sse2, scan_avx2}) {
+            if (!scan_mode_supported(mode)) {
+                printf("  %-7s not supported on this CPU\n", mode_names[mode]);
+                continue;
+            }
+            double best = 1e30;
+            size_t tokens = 0;
+            uint64_t hash = 0;
+            for (int r = 0; r < runs; r++) {
+                auto start = chrono::steady_clock::now();
+                tokens = scan_all(text, mode, hash);
+                best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+            }
+            if (mode == scan_scalar) {
+                scalar = best;
+                expected = hash;
+            } else if (hash != expected) {
+                cerr << mode_names[mode] << " scanned " << path << " differently from scalar\n";
+                return 1;
+            }
+            printf("  %-7s %6.3f GB/s %7.1f M tokens/s %6.2fx\n", mode_names[mode],
+                   text.size() / best / 1e9, tokens / best / 1e6, scalar / best);
+        }
+    }
+    return 0;
+}
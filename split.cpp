@@ -0,0 +1,156 @@
+/* Intra-file parallel parsing.
+    A serial pre-scan tracks if/while ... end nesting and cuts the source at
+    top-level statement starts into a few chunks per thread. Each chunk is
+    parsed as a whole program by its own Parser, and the statement lists
+    are stitched together in order.
+
+    A chunk that parses without errors, and ends exactly at its end of
+    file, parses the same way inside the whole source: the next chunk starts
+    with a token in FIRST(stmt), on which every tail and statement list the
+    chunk left open returns just as it does on eof. The one exception is a
+    chunk that stops after an operator. term() and factor() leave its
+    missing operand as an error node, without a diagnostic, while in the
+    whole source the operator takes the next chunk's first token. So a chunk
+    with an error node, or whose last token is an operator, is bad too.
+
+    The chunks up to the first bad one are kept, and the rest of the source
+    is parsed serially from that chunk's start with the kept transcript,
+    which gives the serial parse's diagnostics and repaired input exactly. A
+    bad cut (nesting miscounted because of an error) only costs parallelism.
+*/
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "split.h"
+
+static const int CHUNKS_PER_THREAD = 4;
+
+/* Returns the start offsets of about n chunks of roughly equal size. Every
+   cut but the first is at a statement start at nesting depth 0: read,
+   write, if, while, or an id followed by :=. */
+static vector <size_t> find_cuts(string_view src, size_t n) {
+    vector <size_t> cuts = {0};
+    if (n < 2) return cuts;
+    ostringstream discard;
+    Scanner scanner(discard);
+    scanner.setSource(src.data(), src.size());
+    size_t step = src.size() / n + 1;
+    size_t target = step;
+    long depth = 0;
+    token prev = t_null;
+    size_t prev_offset = 0;
+    for (token t = scanner.scan(); t != t_eof; t = scanner.scan()) {
+        size_t offset = scanner.token_offset;
+        size_t cut = 0;
+        if (depth == 0 && (t == t_read || t == t_write || t == t_if || t == t_while)) {
+            cut = offset;
+        } else if (depth == 0 && t == t_gets && prev == t_id) {
+            cut = prev_offset;
+        }
+        if (cut >= target && cut > cuts.back()) {
+            cuts.push_back(cut);
+            while (target <= cut) target += step;
+        }
+        if (t == t_if || t == t_while) depth++;
+        else if (t == t_end && depth > 0) depth--;
+        prev = t;
+        prev_offset = offset;
+    }
+    return cuts;
+}
+
+struct Chunk {
+    ostringstream log; // diagnostics, only wanted from the serial path
+    unique_ptr <Parser> parser;
+    AST_Node* root = nullptr;
+    bool ok = false;   // a program node, no errors or error nodes, ended at the chunk's end
+};
+
+AST_Node* split_program (Parser& parser, int jobs, bool table) {
+    string_view src = parser.scanner.source();
+    vector <size_t> cuts = find_cuts(src, size_t(jobs) * CHUNKS_PER_THREAD);
+    if (jobs < 2 || cuts.size() < 2) {
+        parser.input_token = parser.scanner.scan ();
+        return table ? parser.table_program() : parser.program();
+    }
+    cuts.push_back(src.size());
+
+    size_t n = cuts.size() - 1;
+    vector <Chunk> chunks(n);
+    atomic <size_t> next(0);
+    atomic <size_t> first_bad(n); // chunks after a bad one are never used
+    auto work = [&]() {
+        for (size_t i = next++; i < n; i = next++) {
+            if (i > first_bad) continue;
+            Chunk& c = chunks[i];
+            c.parser.reset(new Parser(c.log));
+            Parser& p = *c.parser;
+            p.stats.timing = parser.stats.timing;
+            p.scanner.setSource(src.data(), cuts[i + 1]); /* offsets stay file offsets */
+            p.scanner.seek(cuts[i]);
+            p.input_token = p.scanner.scan ();
+            c.root = table ? p.table_program() : p.program();
+            c.ok = !p.error && !p.stopped() && !c.root->children.empty()
+                && !ends_in_operator(src.substr(cuts[i], cuts[i + 1] - cuts[i])) && !has_error_node(c.root);
+            for (size_t bad = first_bad; !c.ok && i < bad; ) {
+                first_bad.compare_exchange_weak(bad, i);
+            }
+        }
+    };
+    vector <thread> threads;
+    for (int t = 0; t < jobs; t++) {
+        threads.emplace_back(work);
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    for (Chunk& c : chunks) {
+        if (c.parser) parser.stats.add(c.parser->stats);
+    }
+
+    /* Keep the chunks before the first bad one */
+    size_t kept = 0;
+    while (kept < n && chunks[kept].ok) kept++;
+    Arena& arena = parser.arena;
+    SL_Node* sl = arena.make<SL_Node>();
+    size_t count = 0;
+    for (size_t i = 0; i < kept; i++) {
+        count += chunks[i].root->children.front()->children.size();
+        /* Each chunk numbered its symbols on its own */
+        vector <uint32_t> to = arena.adopt(chunks[i].parser->arena);
+        for (AST_Node* s : chunks[i].root->children.front()->children) {
+            relabel(s, to);
+        }
+    }
+    /* The kept chunks matched every token up to the next cut: past the end
+       of the source, eof included, if they all were kept */
+    parser.input.clear();
+    parser.input.keep(0, kept == n ? src.size() + 1 : cuts[kept]);
+
+    AST_Node* rest = nullptr;
+    if (kept == n) {
+        parser.input_token = t_eof;
+    } else {
+        /* Parse the rest serially, as program() would have from here */
+        parser.scanner.seek(cuts[kept]);
+        parser.input_token = parser.scanner.scan ();
+        rest = table ? parser.table_program() : parser.program();
+        if (kept == 0 || parser.stopped()) return rest;
+        count += rest->children.front()->children.size();
+    }
+
+    sl->children.reserve(arena, count);
+    for (size_t i = 0; i < kept; i++) {
+        for (AST_Node* s : chunks[i].root->children.front()->children) {
+            sl->children.push_back(arena, s);
+        }
+    }
+    if (rest != nullptr) {
+        for (AST_Node* s : rest->children.front()->children) {
+            sl->children.push_back(arena, s);
+        }
+    }
+    return arena.make<AST_Node>(s_program, sl);
+}
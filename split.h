@@ -0,0 +1,13 @@
+/* Parsing one large program on several threads */
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include "parse.h"
+
+/* Parses the source given to parser.scanner like parser.program(), or
+   parser.table_program() if table is set, but in chunks on jobs threads.
+   The tree, the diagnostics printed on parser.out, the error state and the
+   transformed input are all exactly those of the serial parse. */
+AST_Node* split_program (Parser& parser, int jobs, bool table);
+
+#endif
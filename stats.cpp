@@ -0,0 +1,62 @@
+/* Process-wide parse statistics and their JSON form; see stats.h */
+#include <algorithm>
+#include <mutex>
+#include "stats.h"
+
+static mutex totals_lock;
+static ParseStats totals;
+
+void ParseStats::add(const ParseStats& other) {
+    parses += other.parses;
+    tokens_scanned += other.tokens_scanned;
+    tokens_skipped += other.tokens_skipped;
+    tokens_inserted += other.tokens_inserted;
+    for (int k = 0; k < 3; k++) {
+        nodes[k] += other.nodes[k];
+    }
+    for (int p = 0; p < n_stat_phases; p++) {
+        ns[p] += other.ns[p];
+    }
+    scan_samples += other.scan_samples;
+}
+
+/* The least time between two clock reads, taken once */
+static uint64_t clock_cost() {
+    static uint64_t cost = [] {
+        uint64_t least = UINT64_MAX;
+        for (int i = 0; i < 1000; i++) {
+            uint64_t start = stat_clock();
+            least = min(least, stat_clock() - start);
+        }
+        return least;
+    }();
+    return cost;
+}
+
+void ParseStats::print(ostream& out) const {
+    static const char* phase_names[] = {"read", "scan", "parse", "recover", "print"};
+    uint64_t sampled = ns[ph_scan] - min(ns[ph_scan], scan_samples * clock_cost());
+    uint64_t scan_ns = scan_samples == 0 ? 0
+        : uint64_t(double(sampled) * tokens_scanned / scan_samples);
+    out << "{\"parses\":" << parses
+        << ",\"tokens_scanned\":" << tokens_scanned
+        << ",\"tokens_skipped\":" << tokens_skipped
+        << ",\"tokens_inserted\":" << tokens_inserted
+        << ",\"nodes\":{\"plain\":" << nodes[0] << ",\"list\":" << nodes[1]
+        << ",\"branch\":" << nodes[2] << "}"
+        << ",\"ns\":{";
+    for (int p = 0; p < n_stat_phases; p++) {
+        out << (p > 0 ? "," : "") << "\"" << phase_names[p] << "\":" << (p == ph_scan ? scan_ns : ns[p]);
+    }
+    out << "},\"scan_samples\":" << scan_samples << "}\n";
+}
+
+void publish_stats(const ParseStats& stats) {
+    lock_guard <mutex> guard(totals_lock);
+    totals.add(stats);
+}
+
+ParseStats collected_stats() {
+    lock_guard <mutex> guard(totals_lock);
+    return totals;
+}
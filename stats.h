@@ -0,0 +1,82 @@
+/* Counters and phase timers for the hot paths of a parse (parse --stats).
+    Counting costs an increment here and there: per token scanned, per
+    token recover() skips or match() inserts, and per node allocated.
+    Timing reads the steady clock around whole phases, and around one
+    scan() in SCAN_SAMPLE, so the scanner's share of a parse is estimated
+    without a clock read per token; it is off unless asked for. Building
+    with -DNO_PARSE_STATS compiles all of it out.
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+#ifdef NO_PARSE_STATS
+#define STAT(x) do { } while (0)
+#else
+#define STAT(x) do { x; } while (0)
+#endif
+
+/* One scan() in this many is timed. The first of a source is not one of
+   them, since it pays for loading the source. */
+const uint64_t SCAN_SAMPLE = 64;
+
+enum stat_phase {ph_read, ph_scan, ph_parse, ph_recover, ph_print, n_stat_phases};
+
+/* Nanoseconds on the steady clock */
+inline uint64_t stat_clock() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ParseStats {
+    bool timing = false; // read the clock; counters are always kept
+
+    uint64_t parses = 0;
+    uint64_t tokens_scanned = 0;
+    uint64_t tokens_skipped = 0;  // by recover(), or deleted by a repair
+    uint64_t tokens_inserted = 0; // by match(), or a repair
+    uint64_t nodes[3] = {};       // allocated, by NodeKind (ast.h)
+    uint64_t ns[n_stat_phases] = {};
+    uint64_t scan_samples = 0;    // scan() calls timed into ns[ph_scan]
+
+    /* Adds other's counts and times to these */
+    void add(const ParseStats& other);
+    /* Writes one JSON object. The scan time is scaled up from the sampled
+       calls to all of them, less the cost of reading the clock, which is
+       about that of scanning a token; parse time includes scan and
+       recovery. */
+    void print(ostream& out) const;
+};
+
+/* Adds the time from its construction to its destruction to a phase */
+class PhaseTimer {
+    public:
+        PhaseTimer(ParseStats& stats, stat_phase phase) : stats(stats), phase(phase) {
+#ifndef NO_PARSE_STATS
+            if (stats.timing) start = stat_clock();
+#endif
+        }
+        ~PhaseTimer() {
+#ifndef NO_PARSE_STATS
+            if (stats.timing) stats.ns[phase] += stat_clock() - start;
+#endif
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+    private:
+        ParseStats& stats;
+        stat_phase phase;
+        uint64_t start = 0;
+};
+
+/* Totals over the process, for a service to scrape: run_parse (batch.h)
+   adds each finished parse here. Both are safe to call from any thread. */
+void publish_stats(const ParseStats& stats);
+ParseStats collected_stats();
+
+#endif
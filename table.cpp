@@ -0,0 +1,415 @@
+/* Table-driven LL(1) parser for the calculator language.
+    Expands nonterminals from predict_table (grammar.h) on an explicit
+    symbol stack instead of recursing, and builds the same AST as the
+    recursive-descent functions in parse.cpp through semantic actions
+    that run on a stack of node values. Error recovery mirrors parse.cpp
+    exactly: match() inserts missing tokens, and stmt_list, stmt, cond and
+    expr call recover().
+
+    With Parser::cost_repair, an error is first handed to a local repair
+    search instead. It tries up to MAX_DELETIONS deletions of the tokens at
+    the error and up to MAX_INSERTIONS insertions before the next one,
+    counting a deletion and an insertion together as a substitution, and
+    keeps the cheapest edit after which the next REPAIR_LOOKAHEAD tokens
+    parse. Each edit is tried on a simulated copy of the parse stack, only
+    the top of which is ever copied. The search stops after REPAIR_BUDGET
+    simulated steps, so the time per error is bounded whatever the input;
+    if it has found nothing by then the greedy recovery runs. In this mode
+    an epsilon prediction is checked against the stack before it is made,
+    so an error is found while the nonterminal a repair may need is still
+    on the stack.
+*/
+#include <chrono>
+#include <climits>
+#include <vector>
+#include "parse.h"
+
+static const int REPAIR_LOOKAHEAD = 5;
+static const int MAX_DELETIONS = 2;
+static const int MAX_INSERTIONS = 2;
+static const size_t REPAIR_BUDGET = 50000;
+
+/* Costs of the edits. An inserted id or literal is made up data, so it
+   costs more than inserted punctuation. */
+static const int DELETE_COST = 2;
+static const int INSERT_COST = 2;
+static const int SUBSTITUTE_COST = 3;
+static const int OPERAND_COST = 1;
+
+/* Semantic actions. Each pops its operands off the value stack and pushes
+   its result. */
+typedef enum {
+    a_none,
+    a_list,       /* push an empty statement list */
+    a_program,    /* [sl eof] -> (program sl) */
+    a_append,     /* [sl s] -> sl with s appended */
+    a_prefix,     /* [op x] -> (op x) */
+    a_infix,      /* [l op r] -> (op l r) */
+    a_branch,     /* [kw c sl end] -> branch node (kw c sl) */
+    a_paren,      /* [( e )] -> e */
+    a_id,         /* [x] -> (id x) */
+    a_num,        /* [x] -> (num x) */
+    a_discard,    /* [x] -> [] */
+    a_error,      /* [] -> ERROR */
+    a_replace,    /* [x] -> ERROR */
+    a_new_list    /* [sl] -> empty statement list */
+} action;
+
+/* Where an action runs within a production: before rhs[position], or after
+   the whole right-hand side if position is past its end. */
+struct Marker {
+    int position;
+    action a;
+};
+
+struct Semantics {
+    Marker markers[2];
+};
+
+/* Semantics of each production of grammar[], in the same order */
+static const Semantics semantics[] = {
+    {{{0, a_list}, {MAX_RHS, a_program}}},  /* program -> stmt_list $$ */
+    {{{1, a_append}}},                      /* stmt_list -> stmt stmt_list */
+    {{}},                                   /* stmt_list -> epsilon */
+    {{{MAX_RHS, a_infix}}},                 /* stmt -> id := expr */
+    {{{MAX_RHS, a_prefix}}},                /* stmt -> read id */
+    {{{MAX_RHS, a_prefix}}},                /* stmt -> write expr */
+    {{{2, a_list}, {MAX_RHS, a_branch}}},   /* stmt -> if cond stmt_list end */
+    {{{2, a_list}, {MAX_RHS, a_branch}}},   /* stmt -> while cond stmt_list end */
+    {{{MAX_RHS, a_infix}}},                 /* cond -> expr ro expr */
+    {{}},                                   /* expr -> term term_tail */
+    {{}},                                   /* term -> factor factor_tail */
+    {{{MAX_RHS, a_paren}}},                 /* factor -> ( expr ) */
+    {{{MAX_RHS, a_id}}},                    /* factor -> id */
+    {{{MAX_RHS, a_num}}},                   /* factor -> lit */
+    {{{2, a_infix}}},                       /* term_tail -> ao term term_tail */
+    {{}},                                   /* term_tail -> epsilon */
+    {{{2, a_infix}}},                       /* factor_tail -> mo factor factor_tail */
+    {{}},                                   /* factor_tail -> epsilon */
+    {{}}, {{}}, {{}}, {{}}, {{}}, {{}},     /* ro -> = | <> | < | > | <= | >= */
+    {{}}, {{}},                             /* ao -> + | - */
+    {{}}, {{}},                             /* mo -> * | / */
+};
+static_assert(sizeof(semantics) / sizeof(semantics[0]) == N_PRODUCTIONS,
+              "one Semantics entry per production");
+
+/* An entry on the parse stack: a grammar symbol or a semantic action */
+struct Item {
+    Symbol s;
+    action a;
+};
+
+/* The parse stack as the repair search sees it: the engine's items up to
+   base, under a top of its own. Trying an edit copies only the top.
+   Actions are popped as null symbols and skipped. */
+struct SimStack {
+    const vector <Item>* below;
+    size_t base;
+    vector <Symbol> top;
+
+    bool empty() const { return top.empty() && base == 0; }
+    Symbol pop() {
+        if (top.empty()) return (*below)[--base].s;
+        Symbol s = top.back();
+        top.pop_back();
+        return s;
+    }
+};
+
+/* A repair: delete the first deleted tokens, then insert these */
+struct Repair {
+    int deleted = 0;
+    vector <token> inserted;
+    int cost = INT_MAX;
+};
+
+/* The stacks of one table-driven parse, over the Parser's scanner and arena */
+class TableEngine {
+    public:
+        TableEngine(Parser& parser) : parser(parser), arena(parser.arena) { }
+        AST_Node* parse ();
+    private:
+        Parser& parser;
+        Arena& arena;
+        vector <Item> stack;
+        vector <AST_Node*> values;
+
+        AST_Node* pop_value();
+        void run(action a);
+        void expand(int p);
+        void predict_error(nonterminal X);
+
+        /* The repair search, for an error at the top of the stack */
+        bool repairable() const;
+        bool viable(token t);
+        bool repair();
+        vector <token> window;    // the tokens at the error
+        size_t steps;             // simulated so far, for this error
+        Repair best;
+        bool feed(SimStack& s, token t);
+        bool accepts(SimStack s, int deleted);
+        void search(const SimStack& s, int deleted, vector <token>& inserted);
+};
+
+static int repair_cost(int deleted, const vector <token>& inserted) {
+    int n = inserted.size();
+    int substituted = min(deleted, n);
+    int cost = substituted * SUBSTITUTE_COST + (deleted - substituted) * DELETE_COST
+        + (n - substituted) * INSERT_COST;
+    for (token t : inserted) {
+        if (t == t_id || t == t_literal) cost += OPERAND_COST;
+    }
+    return cost;
+}
+
+/* Runs the LL(1) automaton on s until it matches t. Returns false if t
+   does not fit, or the budget is spent. */
+bool TableEngine::feed(SimStack& s, token t) {
+    while (!s.empty()) {
+        if (++steps > REPAIR_BUDGET) return false;
+        Symbol x = s.pop();
+        if (x.isTerminal()) return x.c.c == t;
+        if (!x.isNonTerminal()) continue;
+        int p = predict_table.entry[x.X.X][t];
+        if (p < 0) return false;
+        const Symbol* rhs = grammar[p].rhs;
+        int length = 0;
+        while (length < MAX_RHS && (rhs[length].isTerminal() || rhs[length].isNonTerminal())) {
+            length++;
+        }
+        for (int i = length - 1; i >= 0; i--) {
+            s.top.push_back(rhs[i]);
+        }
+    }
+    return false;
+}
+
+/* True if the window after the first deleted tokens parses from s, up to
+   REPAIR_LOOKAHEAD tokens or end of file */
+bool TableEngine::accepts(SimStack s, int deleted) {
+    for (size_t i = deleted; i < window.size() && i < size_t(deleted + REPAIR_LOOKAHEAD); i++) {
+        if (!feed(s, window[i])) return false;
+        if (window[i] == t_eof) return true;
+    }
+    return true;
+}
+
+/* Tries s as it is, then with each token that fits inserted, cheapest first */
+void TableEngine::search(const SimStack& s, int deleted, vector <token>& inserted) {
+    if ((deleted > 0 || !inserted.empty()) && repair_cost(deleted, inserted) < best.cost
+        && accepts(s, deleted)) {
+        best.deleted = deleted;
+        best.inserted = inserted;
+        best.cost = repair_cost(deleted, inserted);
+    }
+    if (inserted.size() == MAX_INSERTIONS || steps > REPAIR_BUDGET) return;
+    for (int t = 0; t < t_eof; t++) {
+        inserted.push_back(token(t));
+        SimStack next = s;
+        if (repair_cost(deleted, inserted) < best.cost && feed(next, token(t))) {
+            search(next, deleted, inserted);
+        }
+        inserted.pop_back();
+    }
+}
+
+bool TableEngine::repairable() const {
+    return parser.cost_repair && !parser.onInserted() && !parser.stopped();
+}
+
+/* True if t can be matched from the stack as it is. An epsilon prediction
+   is made on any token in FOLLOW, which may not fit the actual stack, so
+   the repair search checks it here, before the nonterminal is gone. */
+bool TableEngine::viable(token t) {
+    steps = 0;
+    SimStack s {&stack, stack.size(), {}};
+    return feed(s, t);
+}
+
+/* Looks for the cheapest repair at the error and applies it. Returns false,
+   changing nothing, if none was found within the budget. */
+bool TableEngine::repair() {
+    auto start = chrono::steady_clock::now();
+    window.assign(1, parser.input_token);
+    while (window.size() < REPAIR_LOOKAHEAD + MAX_DELETIONS && window.back() != t_eof) {
+        window.push_back(parser.scanner.peek(window.size()));
+    }
+    steps = 0;
+    best = Repair();
+    vector <token> inserted;
+    for (int deleted = 0; deleted <= MAX_DELETIONS && deleted < int(window.size()); deleted++) {
+        if (deleted > 0 && window[deleted - 1] == t_eof) break;
+        search(SimStack {&stack, stack.size(), {}}, deleted, inserted);
+    }
+    bool found = best.cost < INT_MAX;
+    if (found) parser.repair(best.deleted, best.inserted);
+
+    Parser::RepairStats& stats = parser.repair_stats;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    (found ? stats.repairs : stats.fallbacks)++;
+    stats.seconds += seconds;
+    stats.max_seconds = max(stats.max_seconds, seconds);
+    return found;
+}
+
+AST_Node* TableEngine::pop_value() {
+    AST_Node* v = values.back();
+    values.pop_back();
+    return v;
+}
+
+void TableEngine::run(action a) {
+    switch (a) {
+        case a_none:
+            break;
+        case a_list:
+            values.push_back(arena.make<SL_Node>());
+            break;
+        case a_program: {
+            pop_value(); /* eof */
+            AST_Node* sl = pop_value();
+            values.push_back(arena.make<AST_Node>(s_program, sl));
+            break;
+        }
+        case a_append: {
+            AST_Node* s = pop_value();
+            values.back()->children.push_back(arena, s);
+            if (values.size() == 1 && parser.stream != nullptr) parser.streamStatement(s);
+            break;
+        }
+        case a_prefix: {
+            AST_Node* x = pop_value();
+            AST_Node* op = pop_value();
+            values.push_back(arena.make<AST_Node>(op, x));
+            break;
+        }
+        case a_infix: {
+            AST_Node* r = pop_value();
+            AST_Node* op = pop_value();
+            AST_Node* l = pop_value();
+            values.push_back(arena.make<AST_Node>(op, l, r));
+            break;
+        }
+        case a_branch: {
+            pop_value(); /* end */
+            AST_Node* sl = pop_value();
+            AST_Node* c = pop_value();
+            AST_Node* kw = pop_value();
+            values.push_back(arena.make<B_Node>(kw, c, sl));
+            break;
+        }
+        case a_paren: {
+            pop_value(); /* ) */
+            AST_Node* e = pop_value();
+            pop_value(); /* ( */
+            values.push_back(e);
+            break;
+        }
+        case a_id:
+            values.push_back(arena.make<AST_Node>(t_id, pop_value()));
+            break;
+        case a_num:
+            values.push_back(arena.make<AST_Node>(s_num, pop_value()));
+            break;
+        case a_discard:
+            pop_value();
+            break;
+        case a_error:
+            values.push_back(arena.make<AST_Node>(s_error));
+            break;
+        case a_replace:
+            pop_value();
+            values.push_back(arena.make<AST_Node>(s_error));
+            break;
+        case a_new_list:
+            pop_value();
+            values.push_back(arena.make<SL_Node>());
+            break;
+    }
+}
+
+/* Pushes production p's right-hand side and its actions, last item first */
+void TableEngine::expand(int p) {
+    const Production& prod = grammar[p];
+    const Semantics& sem = semantics[p];
+    int length = 0;
+    while (length < MAX_RHS && (prod.rhs[length].isTerminal() || prod.rhs[length].isNonTerminal())) {
+        length++;
+    }
+    for (int i = MAX_RHS; i >= 0; i--) {
+        if (i < length) stack.push_back({prod.rhs[i], a_none});
+        for (int m = 1; m >= 0; m--) {
+            const Marker& mk = sem.markers[m];
+            int position = mk.position < length ? mk.position : MAX_RHS;
+            if (mk.a != a_none && position == i) {
+                stack.push_back({Symbol(), mk.a});
+            }
+        }
+    }
+}
+
+/* Handles a nonterminal with no prediction for input_token, the way the
+   default case of its recursive-descent function does */
+void TableEngine::predict_error(nonterminal X) {
+    switch (X) {
+        case SL:                /* recover as if inside stmt, then start a new list */
+            stack.push_back({Symbol(SL), a_none});
+            stack.push_back({Symbol(), a_new_list});
+            if (parser.recover(S)) {
+                stack.push_back({Symbol(), a_discard});
+                stack.push_back({Symbol(S), a_none});
+            }
+            break;
+        case S:
+        case C:
+        case E:
+            stack.push_back({Symbol(), a_error});
+            if (parser.recover(X)) {
+                stack.push_back({Symbol(), a_discard});
+                stack.push_back({Symbol(X), a_none});
+            }
+            break;
+        case TT:                /* the tails replace their left operand */
+        case FT:
+            run(a_replace);
+            break;
+        default:
+            run(a_error);
+            break;
+    }
+}
+
+AST_Node* TableEngine::parse () {
+    stack.push_back({Symbol(P), a_none});
+    while (!stack.empty()) {
+        Item top = stack.back();
+        stack.pop_back();
+        if (top.s.isTerminal()) {
+            if (parser.input_token != top.s.c.c && repairable()) {
+                stack.push_back(top);
+                if (repair()) continue;
+                stack.pop_back();
+            }
+            values.push_back(parser.match(top.s.c.c));
+        } else if (top.s.isNonTerminal()) {
+            int p = predict_table.entry[top.s.X.X][parser.input_token];
+            if ((p < 0 || grammar[p].rhs[0].isEpsilon()) && repairable()) {
+                stack.push_back(top);
+                if (!(p >= 0 && viable(parser.input_token)) && repair()) continue;
+                stack.pop_back();
+            }
+            if (p >= 0) {
+                expand(p);
+            } else {
+                predict_error(top.s.X.X);
+            }
+        } else {
+            run(top.a);
+        }
+    }
+    return values.back();
+}
+
+AST_Node* Parser::table_program () {
+    return TableEngine(*this).parse();
+}
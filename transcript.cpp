@@ -0,0 +1,39 @@
+/* Transformed input as edits against the source; see transcript.h */
+#include "parse.h"
+
+void Transcript::keep(size_t from, size_t to) {
+    if (!pieces.empty() && pieces.back().inserted == t_null && pieces.back().to == from) {
+        pieces.back().to = to;
+    } else {
+        pieces.push_back({from, to, t_null});
+    }
+}
+
+/* Rescans each range with a scanner of its own. Scan errors were reported
+   during the parse; here the bad text is skipped silently. */
+void Transcript::print(Emitter& out, string_view source) const {
+    ostream discard(nullptr);
+    Scanner scanner(discard);
+    scanner.errors_fatal = false;
+    scanner.setSource(source.data(), source.size());
+    for (const Piece& p : pieces) {
+        if (p.inserted != t_null) {
+            out.put(names[p.inserted]);
+            out.put(' ');
+            continue;
+        }
+        scanner.seek(p.from);
+        for (;;) {
+            token t = scanner.scan();
+            if (scanner.token_offset >= p.to) break;
+            out.put(scanner.token_image);
+            out.put(' ');
+            if (t == t_eof) break;
+        }
+    }
+}
+
+void Transcript::print(ostream& out, string_view source) const {
+    Emitter emitter(out);
+    print(emitter, source);
+}
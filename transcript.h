@@ -0,0 +1,41 @@
+/* The transformed input printed after syntax errors, kept as edits
+    against the source instead of as text.
+    A parse keeps most tokens, deletes the ones error recovery skips and
+    inserts the ones match() supplies. The transcript records only ranges
+    of kept source and the inserted tokens, so recording a token costs
+    nothing but a compare, and the text is produced by rescanning the
+    source when it is printed.
+*/
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <vector>
+#include "emit.h"
+#include "scan.h"
+
+class Transcript {
+    public:
+        void clear() { pieces.clear(); }
+
+        /* Keeps every token of the source that starts in [from, to). A
+           range that begins where the last one ended extends it. The eof
+           token, which has no length, is kept by a range ending past it. */
+        void keep(size_t from, size_t to);
+        /* Appends a token that is not in the source */
+        void insert(token t) { pieces.push_back({0, 0, t}); }
+
+        /* Writes each kept token's text and each inserted token's name,
+           every one followed by a space. source must be the source the
+           offsets refer to. */
+        void print(Emitter& out, string_view source) const;
+        void print(ostream& out, string_view source) const;
+    private:
+        struct Piece {
+            size_t from;
+            size_t to;
+            token inserted; // t_null for a range of source
+        };
+        vector <Piece> pieces;
+};
+
+#endif
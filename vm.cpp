@@ -0,0 +1,316 @@
+/* Bytecode compiler and interpreter; see vm.h.
+    Expressions are compiled down their left spine in a loop, since a long
+    sum or product is a left-deep chain of nodes, and recursion is left to
+    right operands and nested statements, which the parser itself reached
+    by recursion. Temporaries are numbered apart while compiling, because
+    the number of variables and literals is only known at the end, and are
+    moved above them then.
+*/
+#include <charconv>
+#include "vm.h"
+
+static const uint32_t NO_SLOT = UINT32_MAX;
+static const uint32_t TEMP = 0x80000000; // marks a temporary's slot until the end
+
+static const char* op_names[] = {"mov", "add", "sub", "mul", "div", "jeq", "jne", "jlt",
+                                 "jgt", "jle", "jge", "jmp", "read", "write", "halt"};
+static_assert(sizeof(op_names) / sizeof(op_names[0]) == n_opcodes, "an opcode has no name");
+
+/* Which of an instruction's operands are slots */
+static bool slot_a(opcode op) { return op <= op_div || op == op_read || op == op_write; }
+static bool slot_b(opcode op) { return op <= op_jge; }
+static bool slot_c(opcode op) { return op >= op_add && op <= op_jge; }
+
+namespace {
+
+class Compiler {
+    public:
+        Compiler(const Arena& arena, Program& program, RunError& error)
+            : arena(arena), program(program), error(error), slot_of(arena.symbolCount(), NO_SLOT) { }
+        bool run(const AST_Node* root);
+    private:
+        const Arena& arena;
+        Program& program;
+        RunError& error;
+        vector <uint32_t> slot_of; // the slot of each variable or literal, by symbol
+        uint32_t temps = 0;        // temporaries in use
+        uint32_t most_temps = 0;
+        uint32_t at = NO_OFFSET;   // offset of the statement being compiled
+
+        bool statement(const AST_Node* n);
+        bool condition(const AST_Node* n, bool jump_if, size_t& jump);
+        uint32_t expr(const AST_Node* n, uint32_t dest);
+        uint32_t operand(const AST_Node* n);
+        size_t emit(opcode op, uint32_t a, uint32_t b, uint32_t c, uint32_t offset);
+        bool fail(const char* message, const AST_Node* n);
+};
+
+}
+
+const AST_Node* skip_wrappers(const AST_Node* n) {
+    while (n->kind == n_plain && (n->label == t_id || n->label == s_num) && n->children.size() == 1) {
+        n = n->children[0];
+    }
+    return n;
+}
+
+LeafKind read_leaf(const AST_Node* n, const Arena& arena, int64_t& value) {
+    if (!n->children.empty() || n->label >= arena.symbolCount()) return leaf_other;
+    string_view s = arena.label(n->label);
+    if (s.size() < 3 || s.front() != '"' || s.back() != '"') return leaf_other;
+    s = s.substr(1, s.size() - 2);
+    if (s[0] != '-' && (s[0] < '0' || s[0] > '9')) return leaf_variable;
+    auto [end, failed] = from_chars(s.data(), s.data() + s.size(), value);
+    return failed != errc() || end != s.data() + s.size() ? leaf_too_big : leaf_literal;
+}
+
+static bool arithmetic(const AST_Node* n) {
+    return n->kind == n_plain && n->children.size() == 2 && n->label >= t_add && n->label <= t_div;
+}
+
+size_t Compiler::emit(opcode op, uint32_t a, uint32_t b, uint32_t c, uint32_t offset) {
+    program.code.push_back({op, a, b, c});
+    program.offsets.push_back(offset);
+    return program.code.size() - 1;
+}
+
+bool Compiler::fail(const char* message, const AST_Node* n) {
+    if (error.message.empty()) {
+        error.message = message;
+        /* Error nodes have no offset of their own */
+        error.offset = n->offset != NO_OFFSET ? n->offset : at;
+    }
+    return false;
+}
+
+/* The slot of a variable or literal leaf, or NO_SLOT after fail() */
+uint32_t Compiler::operand(const AST_Node* n) {
+    if (n->label == s_error) {
+        fail("the parser left an error node here", n);
+        return NO_SLOT;
+    }
+    if (n->label < slot_of.size() && slot_of[n->label] != NO_SLOT) return slot_of[n->label];
+    int64_t value = 0;
+    switch (read_leaf(n, arena, value)) {
+        case leaf_variable:
+            value = 0;
+            break;
+        case leaf_literal:
+            break;
+        case leaf_too_big:
+            fail("literal does not fit in 64 bits", n);
+            return NO_SLOT;
+        default:
+            fail("cannot run this node", n);
+            return NO_SLOT;
+    }
+    slot_of[n->label] = program.slots.size();
+    program.slots.push_back(value);
+    return slot_of[n->label];
+}
+
+/* Compiles n and returns the slot that holds its value: dest if n is an
+   operation and dest is given, else an operand's or a temporary's slot */
+uint32_t Compiler::expr(const AST_Node* n, uint32_t dest) {
+    vector <const AST_Node*> spine;
+    for (n = skip_wrappers(n); arithmetic(n); n = skip_wrappers(n->children[0])) {
+        spine.push_back(n);
+    }
+    uint32_t value = operand(n);
+    uint32_t chain = NO_SLOT; // the temporary that holds the chain so far
+    for (size_t i = spine.size(); i-- > 0 && value != NO_SLOT; ) {
+        uint32_t mark = temps;
+        uint32_t right = expr(spine[i]->children[1], NO_SLOT);
+        if (right == NO_SLOT) return NO_SLOT;
+        temps = mark;
+        /* Only the last operation may write dest, which may be a variable
+           that the operands further up the chain still read */
+        uint32_t to = i == 0 && dest != NO_SLOT ? dest : chain;
+        if (to == NO_SLOT) {
+            to = chain = TEMP | temps++;
+            most_temps = max(most_temps, temps);
+        }
+        emit(opcode(op_add + (spine[i]->label - t_add)), to, value, right, spine[i]->offset);
+        value = to;
+    }
+    return value;
+}
+
+/* Compiles a comparison and a jump taken when it is jump_if, whose target
+   is left for the caller to set */
+bool Compiler::condition(const AST_Node* n, bool jump_if, size_t& jump) {
+    /* The jumps taken when a comparison is false */
+    static const opcode negated[] = {op_jne, op_jeq, op_jge, op_jle, op_jgt, op_jlt};
+    if (n->kind != n_plain || n->children.size() != 2 || n->label < t_eq || n->label > t_geq) {
+        return fail("cannot run this condition", n);
+    }
+    uint32_t mark = temps;
+    uint32_t left = expr(n->children[0], NO_SLOT);
+    uint32_t right = left == NO_SLOT ? NO_SLOT : expr(n->children[1], NO_SLOT);
+    temps = mark;
+    if (right == NO_SLOT) return false;
+    opcode op = jump_if ? opcode(op_jeq + (n->label - t_eq)) : negated[n->label - t_eq];
+    jump = emit(op, 0, left, right, n->offset);
+    return true;
+}
+
+bool Compiler::statement(const AST_Node* n) {
+    if (n->kind == n_list || n->label == s_program) {
+        for (const AST_Node* s : n->children) {
+            if (!statement(s)) return false;
+        }
+        return true;
+    }
+    at = n->offset;
+    size_t arity = n->label == t_read || n->label == t_write ? 1 : 2;
+    switch (n->children.size() == arity ? n->label : uint32_t(s_error)) {
+        case t_gets: {
+            uint32_t var = operand(n->children[0]);
+            uint32_t value = var == NO_SLOT ? NO_SLOT : expr(n->children[1], var);
+            if (value == NO_SLOT) return false;
+            if (value != var) emit(op_mov, var, value, 0, n->offset);
+            temps = 0;
+            return true;
+        }
+        case t_read: {
+            uint32_t var = operand(skip_wrappers(n->children[0]));
+            if (var == NO_SLOT) return false;
+            emit(op_read, var, 0, 0, n->offset);
+            return true;
+        }
+        case t_write: {
+            uint32_t value = expr(n->children[0], NO_SLOT);
+            if (value == NO_SLOT) return false;
+            emit(op_write, value, 0, 0, n->offset);
+            temps = 0;
+            return true;
+        }
+        case t_if: {
+            size_t skip;
+            if (!condition(n->children[0], false, skip) || !statement(n->children[1])) return false;
+            program.code[skip].a = program.code.size();
+            return true;
+        }
+        case t_while: {
+            /* Enter at the test, which jumps back to the body while it holds */
+            size_t enter = emit(op_jmp, 0, 0, 0, n->offset);
+            size_t body = program.code.size();
+            if (!statement(n->children[1])) return false;
+            program.code[enter].a = program.code.size();
+            at = n->offset;
+            size_t repeat;
+            if (!condition(n->children[0], true, repeat)) return false;
+            program.code[repeat].a = body;
+            return true;
+        }
+        default:
+            return fail("cannot run this statement", n);
+    }
+}
+
+bool Compiler::run(const AST_Node* root) {
+    if (!statement(root)) return false;
+    emit(op_halt, 0, 0, 0, NO_OFFSET);
+    uint32_t fixed = program.slots.size();
+    program.frame_size = fixed + most_temps;
+    for (Instr& i : program.code) {
+        if (slot_a(i.op) && (i.a & TEMP)) i.a = fixed + (i.a & ~TEMP);
+        if (slot_b(i.op) && (i.b & TEMP)) i.b = fixed + (i.b & ~TEMP);
+        if (slot_c(i.op) && (i.c & TEMP)) i.c = fixed + (i.c & ~TEMP);
+    }
+    return true;
+}
+
+bool compile(const AST_Node* root, const Arena& arena, Program& program, RunError& error) {
+    program = Program();
+    error = RunError();
+    return Compiler(arena, program, error).run(root);
+}
+
+bool Program::run(istream& in, ostream& out, RunError& error) const {
+    /* In opcode order */
+    static const void* const handlers[] = {
+        &&do_mov, &&do_add, &&do_sub, &&do_mul, &&do_div, &&do_jeq, &&do_jne, &&do_jlt,
+        &&do_jgt, &&do_jle, &&do_jge, &&do_jmp, &&do_read, &&do_write, &&do_halt
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == n_opcodes, "an opcode has no handler");
+
+    vector <int64_t> frame(slots);
+    frame.resize(frame_size, 0);
+    int64_t* r = frame.data();
+    const Instr* start = code.data();
+    const Instr* ip = start;
+    Emitter written(out, 1 << 16);
+    char digits[24];
+
+#define NEXT goto *handlers[ip->op]
+#define JUMP_IF(test) ip = (test) ? start + ip->a : ip + 1; NEXT
+    NEXT;
+do_mov:
+    r[ip->a] = r[ip->b];
+    ip++;
+    NEXT;
+do_add:
+    r[ip->a] = int64_t(uint64_t(r[ip->b]) + uint64_t(r[ip->c]));
+    ip++;
+    NEXT;
+do_sub:
+    r[ip->a] = int64_t(uint64_t(r[ip->b]) - uint64_t(r[ip->c]));
+    ip++;
+    NEXT;
+do_mul:
+    r[ip->a] = int64_t(uint64_t(r[ip->b]) * uint64_t(r[ip->c]));
+    ip++;
+    NEXT;
+do_div:
+    if (r[ip->c] == 0) {
+        error.message = "division by zero";
+        goto stop;
+    }
+    /* INT64_MIN / -1 wraps like the other operations */
+    r[ip->a] = r[ip->c] == -1 ? int64_t(0 - uint64_t(r[ip->b])) : r[ip->b] / r[ip->c];
+    ip++;
+    NEXT;
+do_jeq: JUMP_IF(r[ip->b] == r[ip->c]);
+do_jne: JUMP_IF(r[ip->b] != r[ip->c]);
+do_jlt: JUMP_IF(r[ip->b] < r[ip->c]);
+do_jgt: JUMP_IF(r[ip->b] > r[ip->c]);
+do_jle: JUMP_IF(r[ip->b] <= r[ip->c]);
+do_jge: JUMP_IF(r[ip->b] >= r[ip->c]);
+do_jmp:
+    ip = start + ip->a;
+    NEXT;
+do_read:
+    if (!(in >> r[ip->a])) {
+        error.message = "read found no integer in the input";
+        goto stop;
+    }
+    ip++;
+    NEXT;
+do_write: {
+    char* end = to_chars(digits, digits + sizeof(digits) - 1, r[ip->a]).ptr;
+    *end++ = '\n';
+    written.put(string_view(digits, end - digits));
+    ip++;
+    NEXT;
+}
+do_halt:
+    return true;
+stop:
+    error.offset = offsets[ip - start];
+    return false;
+#undef JUMP_IF
+#undef NEXT
+}
+
+void Program::print(ostream& out) const {
+    for (size_t i = 0; i < code.size(); i++) {
+        const Instr& in = code[i];
+        out << i << "\t" << op_names[in.op];
+        if (in.op == op_jmp || (in.op >= op_jeq && in.op <= op_jge)) out << " @" << in.a;
+        else if (slot_a(in.op)) out << " r" << in.a;
+        if (slot_b(in.op)) out << " r" << in.b;
+        if (slot_c(in.op)) out << " r" << in.c;
+        out << "\n";
+    }
+}
@@ -0,0 +1,80 @@
+/* Bytecode backend: runs a parsed program (parse --run).
+    compile() lowers the AST to register code. Each variable gets a slot in
+    the frame the first time it is compiled, and each distinct literal a
+    slot that holds its value from the start, so every operand is a slot
+    number and nothing is looked up by name while the program runs.
+    Intermediate values take temporary slots above those, reused like a
+    stack. A comparison and the jump that tests it are one instruction, and
+    a while loop tests its condition at the bottom, so an iteration costs
+    one branch.
+
+    Program::run dispatches through GCC's labels as values: every handler
+    ends with its own indirect jump through the table of handlers (token
+    threading), so the branch predictor sees one jump per opcode rather
+    than the single shared one of a switch.
+
+    Values are 64-bit integers and arithmetic wraps around. Variables start
+    at 0. read takes the next integer from the input and write prints a
+    value on a line of its own.
+*/
+#ifndef VM_H
+#define VM_H
+
+#include "ast.h"
+
+/* Operands are frame slots; a jump's target is an index into the code */
+enum opcode : uint32_t {
+    op_mov,                          // a = b
+    op_add, op_sub, op_mul, op_div,  // a = b op c
+    op_jeq, op_jne, op_jlt, op_jgt, op_jle, op_jge, // jump to a if b rel c
+    op_jmp,                          // jump to a
+    op_read, op_write,               // read into a, write a
+    op_halt,
+    n_opcodes
+};
+
+struct Instr {
+    opcode op;
+    uint32_t a, b, c;
+};
+
+/* Why a program could not be compiled or stopped early, and the source
+   offset of the token responsible */
+struct RunError {
+    string message;
+    uint32_t offset = NO_OFFSET;
+};
+
+class Program {
+    public:
+        vector <Instr> code;
+        vector <uint32_t> offsets; // source offset of each instruction
+        vector <int64_t> slots;    // start values of the variable and literal slots
+        uint32_t frame_size = 0;   // those and the temporaries
+
+        /* Runs the program, reading from in and writing to out. Returns
+           false, with error set, if it divides by zero or reads past the
+           last integer of its input. */
+        bool run(istream& in, ostream& out, RunError& error) const;
+
+        /* Prints the code, one instruction a line */
+        void print(ostream& out) const;
+};
+
+/* What a leaf of a runnable tree is: a quoted variable name or a quoted
+   literal, which is negative if the simplification pass folded it so */
+enum LeafKind {leaf_variable, leaf_literal, leaf_too_big, leaf_other};
+
+/* Reads the leaf n, setting value if it is a literal */
+LeafKind read_leaf(const AST_Node* n, const Arena& arena, int64_t& value);
+
+/* Skips the id and num wrappers, which the simplification pass removes */
+const AST_Node* skip_wrappers(const AST_Node* n);
+
+/* Compiles the tree under root, labelled from arena, into program. root
+   may be a program or the simplified tree or DAG of optimize (opt.h).
+   Returns false, with error set, if a literal does not fit in 64 bits or
+   the tree has a node that cannot be run, such as an error node. */
+bool compile(const AST_Node* root, const Arena& arena, Program& program, RunError& error);
+
+#endif